@@ -24,7 +24,14 @@ CParamSmooth::CParamSmooth(float smoothingTimeInMs, float samplingRate)
     z = 0.0f;
 }
 
+void CParamSmooth::setSamplingRate(float smoothingTimeInMs, float samplingRate)
+{
+    const float c_twoPi = 6.283185307179586476925286766559f;
     
+    a = exp(-c_twoPi / (smoothingTimeInMs * 0.001f * samplingRate));
+    b = 1.0f - a;
+}
+
 double CParamSmooth::process(double in)
 {
     z = (in * b) + (z * a);
@@ -18,6 +18,9 @@ public:
                  
     double process(double in);
 
+    // a new rate for the same smoothing time, carrying on from the current value
+    void setSamplingRate(float smoothingTimeInMs, float samplingRate);
+
 private:
     float a;
     float b;
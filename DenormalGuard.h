@@ -0,0 +1,51 @@
+//
+//  DenormalGuard.h
+//  MultibandDistortion
+//
+//  Flush-to-zero and denormals-are-zero for the lifetime of a scope, restoring
+//  the caller's floating point mode afterwards. The mode is per thread, so every
+//  thread that runs DSP code sets its own scope. While it is active, denormal
+//  results (filter feedback tails, decaying envelopes) become zero and denormal
+//  inputs read as zero, so they can not slow the arithmetic down and need no
+//  checks of their own.
+//
+//  SSE (x86-64, or 32-bit x86 with SSE2 math) sets FTZ and DAZ in MXCSR; AArch64
+//  sets FZ in FPCR. Anywhere else the scope does nothing and
+//  DENORMALS_FLUSHED_IN_HARDWARE is 0, so code keeps its explicit checks there.
+//
+
+#ifndef DenormalGuard_h
+#define DenormalGuard_h
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2_MATH__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <xmmintrin.h>
+#define DENORMALS_FLUSHED_IN_HARDWARE 1
+#define DENORMAL_GUARD_SSE
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define DENORMALS_FLUSHED_IN_HARDWARE 1
+#define DENORMAL_GUARD_AARCH64
+#else
+#define DENORMALS_FLUSHED_IN_HARDWARE 0
+#endif
+
+class FlushDenormalsScope {
+public:
+#if defined(DENORMAL_GUARD_SSE)
+    FlushDenormalsScope() : mSaved(_mm_getcsr()) { _mm_setcsr(mSaved | 0x8040); } // FTZ | DAZ
+    ~FlushDenormalsScope() { _mm_setcsr(mSaved); }
+
+private:
+    unsigned int mSaved;
+#elif defined(DENORMAL_GUARD_AARCH64)
+    FlushDenormalsScope() {
+        __asm__ __volatile__("mrs %0, fpcr" : "=r"(mSaved));
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(mSaved | (1ull << 24))); // FZ
+    }
+    ~FlushDenormalsScope() { __asm__ __volatile__("msr fpcr, %0" : : "r"(mSaved)); }
+
+private:
+    unsigned long long mSaved;
+#endif
+};
+
+#endif /* DenormalGuard_h */
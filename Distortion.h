@@ -0,0 +1,169 @@
+//
+//  Distortion.h
+//  MultibandDistortion
+//
+//  The per-band waveshapers, free of any IPlug dependency so they can be
+//  used by the plugin and by the command line tools alike. They are templates
+//  on the sample type; the constants are rounded to the sample type, so the
+//  float versions stay in single precision.
+//
+
+#ifndef Distortion_h
+#define Distortion_h
+
+#define _USE_MATH_DEFINES		// to use M_PI
+#include <cmath>
+
+enum DistortionMode {
+    DistExcite = 0,
+    DistFat,
+    DistSine,
+    DistFold,
+    DistTanh,
+    DistSoft,
+    DistChebyshev,
+    NumDistortionModes
+};
+
+//Highest order the Chebyshev mode runs at
+enum { kMaxChebyshevOrder = 8 };
+
+template <typename T>
+inline T fastAtan(T x){
+    return (x / (T(1.0) + T(0.28) * (x * x)));
+}
+
+//  Chebyshev: a weighted sum of the Chebyshev polynomials T_1 to T_order of
+//  the input clamped to [-1, 1]. Each order's weights are the Chebyshev series
+//  of the integral of (1 - x^2)^m scaled to reach 1 at 1, for the largest m
+//  whose degree 2m + 1 is within the order. So every curve rises monotonically
+//  from -1 to 1 with zero slope at both ends and meets the clamp at the same
+//  level without a corner; the higher orders are steeper around zero, 1.5 for
+//  orders 3 and 4 up to 2.19 for 7 and 8. The curves are odd, an even order
+//  runs the odd one below it, and the harmonics are odd ones only.
+//  As T_k(cos t) = cos(k t), a sine within [-1, 1] comes out with harmonics up
+//  to the order and none above, so an order that keeps order times the band's
+//  top frequency under Nyquist does not alias; louder input, where the clamp
+//  takes over, makes some above. No such curve has an order below 3: orders 1
+//  and 2 pass the samples unchanged, so a band whose top edge is above a third
+//  of Nyquist at its shaping rate is left unshaped rather than aliased. The
+//  top band is shaped from 4x oversampling up.
+//  Evaluated with Clenshaw's recurrence, sixteen samples side by side so the
+//  compiler can vectorise the inner loops.
+template <typename T>
+inline void ProcessChebyshev(T* samples, int n, int order){
+    //the weights of T_0 to T_8 for m = 1, 2 and 3, orders 3-4, 5-6 and 7-8
+    static const T weights[3][kMaxChebyshevOrder + 1] = {
+        { T(0), T(9/8.), T(0), T(-1/8.), T(0), T(0), T(0), T(0), T(0) },
+        { T(0), T(75/64.), T(0), T(-25/128.), T(0), T(3/128.), T(0), T(0), T(0) },
+        { T(0), T(1225/1024.), T(0), T(-245/1024.), T(0), T(49/1024.), T(0), T(-5/1024.), T(0) } };
+    if (order < 3) return;
+    if (order > kMaxChebyshevOrder) order = kMaxChebyshevOrder;
+    const T* w = weights[(order - 1) / 2 - 1];
+
+    for (int start=0; start<n; start+=16) {
+        const int m = n - start < 16 ? n - start : 16;
+        T x[16], b1[16], b2[16];
+        for (int i=0; i<m; i++) {
+            const T sample = samples[start + i];
+            x[i] = sample > 1 ? T(1) : (sample < -1 ? T(-1) : sample);
+            b1[i] = b2[i] = 0;
+        }
+        for (int k=order; k>=1; k--) {
+            for (int i=0; i<m; i++) {
+                const T b0 = w[k] + 2 * x[i] * b1[i] - b2[i];
+                b2[i] = b1[i];
+                b1[i] = b0;
+            }
+        }
+        for (int i=0; i<m; i++) samples[start + i] = x[i] * b1[i] - b2[i];
+    }
+}
+
+template <typename T>
+inline T ProcessDistortion(T sample, int distType){
+    //Excite
+    //Soft asymmetrical clipping
+    if (distType==DistExcite) {
+        const T threshold = 0.6;
+        if(sample>threshold)
+            sample = threshold + (sample - threshold) / (1 + std::pow(((sample - threshold)/(1 - threshold)), T(2)));
+        else if(sample >1)
+            sample=1;
+    }
+
+    //Fat
+    //arctan waveshaper
+    else if(distType==DistFat){
+        sample =  T(1/2.) * fastAtan(sample * 2);
+    }
+
+    //Sine shaper
+    //based on Jon Watte's waveshaper algorithm. Modified for softer clipping
+    else if(distType==DistSine){
+        const double amount = 3.;
+        const T z = T(M_PI * amount/4.0);
+        const T s = T(1/sin(M_PI * amount/4.0));
+        const T b = T(1 / amount);
+
+        if (sample>b)
+            sample = sample + (1-sample)*T(0.8);
+        else if (sample < - b)
+            sample = sample + (-1-sample)*T(0.8);
+        else
+            sample = std::sin(z * sample) * s;
+
+        sample *= T(pow(10, -amount/20.0));
+    }
+
+    //Foldback Distortion
+    //algorithm by hellfire@upb.de, from musicdsp.org archives
+    else if(distType==DistFold){
+        const T threshold = .6;
+        if (sample > threshold || sample < - threshold)
+            sample = std::fabs(std::fabs(std::fmod(sample - threshold, threshold * 4)) - threshold * 2) - threshold;
+    }
+
+    //Tanh Waveshaper
+    else if (distType==DistTanh){
+        sample=T(1/3.) * std::tanh(sample * T(3.));
+    }
+
+    //soft saturation
+    // from "A perceptual approach on clipping and saturation" by Stefania Barbati and Thomas Serafini for simulanalog.org
+    else if (distType==DistSoft){
+        if(sample>=1)
+            sample = T(.5);
+        else if(sample<1 && sample >= 0)
+            sample = T(-.5) * sample * sample + sample;
+        else if(sample<0 && sample > -1)
+            sample = T(.5) * sample * sample + sample;
+        else
+            sample = T(-.5);
+    }
+
+    //Chebyshev, at its highest order
+    else if (distType==DistChebyshev){
+        ProcessChebyshev(&sample, 1, (int)kMaxChebyshevOrder);
+    }
+    return sample;
+}
+
+//  The waveshaper over n samples. The mode is switched once, outside the loops,
+//  so each mode gets a loop of its own the compiler can vectorise where the
+//  shaper allows it.
+template <typename T>
+inline void ProcessDistortion(T* samples, int n, int distType){
+    switch (distType) {
+        case DistExcite: for (int i=0; i<n; i++) samples[i] = ProcessDistortion(samples[i], (int)DistExcite); break;
+        case DistFat: for (int i=0; i<n; i++) samples[i] = ProcessDistortion(samples[i], (int)DistFat); break;
+        case DistSine: for (int i=0; i<n; i++) samples[i] = ProcessDistortion(samples[i], (int)DistSine); break;
+        case DistFold: for (int i=0; i<n; i++) samples[i] = ProcessDistortion(samples[i], (int)DistFold); break;
+        case DistTanh: for (int i=0; i<n; i++) samples[i] = ProcessDistortion(samples[i], (int)DistTanh); break;
+        case DistSoft: for (int i=0; i<n; i++) samples[i] = ProcessDistortion(samples[i], (int)DistSoft); break;
+        case DistChebyshev: ProcessChebyshev(samples, n, (int)kMaxChebyshevOrder); break;
+        default: break;
+    }
+}
+
+#endif /* Distortion_h */
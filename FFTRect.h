@@ -4,8 +4,10 @@
 #include <vector>
 #include <algorithm>
 #include <sstream>
+#include <atomic>
 #include "denormal.h"
 #include "fft.h"
+#include "TapRing.h"
 
 
 /*
@@ -98,6 +100,7 @@ public:
 
     void ClearBuffers() {
         SetBufferSize();
+        SetOverlapPosition();
     }
 
     void SetOverlapSize(const int x) {
@@ -185,8 +188,15 @@ protected:
 
     void CalculateWindowFx(const int type = -1) {
         int wType = type;
-        const double M = fftSize - 1.;
         if (wType == -1) wType = windowType;
+        FillWindow(vWindowFx, wType);
+    }
+
+public:
+    // fills the whole vector with the given window, shared with Spect_MultiResFFT
+    static void FillWindow(std::vector<double>& vWindowFx, const int wType) {
+        const int fftSize = (int)vWindowFx.size();
+        const double M = fftSize - 1.;
         for (int i = 0; i < fftSize; i++) {
             if (wType == win_Hann)  vWindowFx[i] = 0.5 * (1. - std::cos(pi2 * i / M)); 
             else if (wType == win_BlackmanHarris)  vWindowFx[i] = 0.35875 - (0.48829 * cos(pi2*i / M)) + (0.14128*cos(pi4*i / M)) - (0.01168 * cos(6.0 * pi * i / M));  
@@ -196,6 +206,8 @@ protected:
         }
     }
 
+protected:
+
     void CalculateSValues() {
         S1 = 0.;
         S2 = 0.;
@@ -220,9 +232,397 @@ protected:
 
 };
 
+// Multi-resolution FFT for log-frequency displays, for several streams at once.
+// The input is repeatedly halfband filtered and decimated by 2, and each decimation stage frames
+// its own short FFT. Every display pixel reads from the most decimated stage that still covers
+// its frequency, so the bin spacing grows with frequency (constant-Q-like): a 512 point stage at
+// 1/64th of the sample rate resolves the bass like a 32k FFT, while the top stage keeps the highs
+// responsive. Pixels spanning several bins take the bin maximum instead of dropping them.
+// With a single stage this is a plain FFT analyzer.
+//
+// All streams are fed in lockstep, so their frames complete together and are transformed as one
+// batch with the same window: two real streams are packed into the real and imaginary parts of a
+// single complex FFT and separated afterwards. Only active streams are framed and transformed.
+class Spect_MultiResFFT {
+public:
+    Spect_MultiResFFT(IPlugBase* pPlug, const int stagesize, const int numstages, const double samplerate, const int numstreams = 1) {
+        stageSize = stagesize;
+        sampleRate = samplerate;
+        numStreams = numstreams;
+        windowType = Spect_FFT::win_Hann;
+        WDL_fft_init();
+        vPermute = WDL_fft_permute_tab(stageSize);
+        vScratch.resize(stageSize);
+        vStageIn.resize(numStreams);
+        vActive.assign(numStreams, false);
+        vActive[0] = true;
+        CalculateHalfband();
+        CalculateWindowFx();
+        vStage.resize(numstages);
+        for (int k = 0; k < numstages; k++) {
+            // the top stage is fast enough without overlap, decimated stages need it to keep up
+            vStage[k].overlap = (k == 0 && numstages > 1) ? 1 : 2;
+            vStage[k].vHistory.resize(numStreams * stageSize);
+            vStage[k].vOutPut.resize(numStreams * (stageSize / 2 + 1));
+            vStage[k].vDecimator.resize(k > 0 ? numStreams * 2 * halfbandLength : 0);
+        }
+        ClearBuffers();
+    }
+    ~Spect_MultiResFFT() {}
+
+    void ClearBuffers() {
+        for (std::vector<sStage>::iterator it = vStage.begin(); it != vStage.end(); ++it) {
+            std::fill(it->vHistory.begin(), it->vHistory.end(), 0.);
+            std::fill(it->vOutPut.begin(), it->vOutPut.end(), 0.);
+            std::fill(it->vDecimator.begin(), it->vDecimator.end(), 0.);
+            it->position = 0;
+            it->decimatorPosition = 0;
+            it->hopCount = 0;
+            it->skip = true;
+        }
+    }
+
+    void SetWindowType(const int type) {
+        windowType = type;
+        CalculateWindowFx();
+    }
+
+    void SetSampleRate(const double sr) {
+        if (sr == sampleRate) return;
+        sampleRate = sr;
+        CalculatePixelMap();
+        ClearBuffers();
+    }
+
+    // frequencies of the display columns, see gFFTAnalyzer::GetPixelFrequencies()
+    void SetPixelFrequencies(const std::vector<double>& freqs) {
+        vPixelFreq = freqs;
+        CalculatePixelMap();
+    }
+
+    void SetStreamActive(const int stream, const bool active) {
+        vActive[stream] = active;
+        vActiveList.resize(0);
+        for (int i = 0; i < numStreams; i++) {
+            if (vActive[i]) vActiveList.push_back(i);
+        }
+    }
+
+    bool IsStreamActive(const int stream) const { return vActive[stream]; }
+
+    // one sample for every stream, only the active ones are read
+    void SendInput(const float* in) {
+        const int nActive = (int)vActiveList.size();
+        for (int i = 0; i < nActive; i++) {
+            vStageIn[i] = in[vActiveList[i]];
+        }
+        for (int k = 0; k < (int)vStage.size(); k++) {
+            sStage& st = vStage[k];
+            if (k > 0 && !Decimate(st)) break;
+
+            for (int i = 0; i < nActive; i++) {
+                st.vHistory[vActiveList[i] * stageSize + st.position] = vStageIn[i];
+            }
+            if (++st.position >= stageSize) st.position = 0;
+            if (++st.hopCount >= stageSize / st.overlap) {
+                st.hopCount = 0;
+                Transform(st);
+            }
+        }
+    }
+
+    // counts completed transforms, a change means there is something new to show
+    unsigned int GetFrameCount() const { return frameCount; }
+
+    int GetNumPixels() const { return (int)vPixelMap.size(); }
+
+    double GetPixelOutput(const int px, const int stream = 0) const {
+        const sPixelMap& m = vPixelMap[px];
+        const double* bins = &vStage[m.stage].vOutPut[stream * (stageSize / 2 + 1)];
+        if (m.interpolate) {
+            return LinInterp(0., bins[m.binLo], 1., bins[m.binLo + 1], m.frac);
+        }
+        double v = 0.;
+        for (int b = m.binLo; b <= m.binHi; b++) {
+            v = std::max(v, bins[b]);
+        }
+        return v;
+    }
+
+protected:
+    struct sStage
+    {
+        int overlap, hopCount;
+        int position;                    // oldest sample in the history
+        bool skip;                       // drops every other sample of the previous stage
+        int decimatorPosition;
+        std::vector<double> vHistory;    // stageSize per stream
+        std::vector<double> vOutPut;     // stageSize/2+1 magnitudes per stream
+        std::vector<double> vDecimator;  // halfband history per stream, stored twice so taps never wrap
+    };
+
+    struct sPixelMap
+    {
+        int stage;
+        int binLo, binHi;
+        bool interpolate;
+        double frac;
+    };
+
+    // halfband lowpass of the previous stage's samples (in vStageIn) followed by dropping every
+    // other sample, returns true when the stage has a new input
+    bool Decimate(sStage& st) {
+        const int nActive = (int)vActiveList.size();
+        st.decimatorPosition = (st.decimatorPosition == 0) ? halfbandLength - 1 : st.decimatorPosition - 1;
+        for (int i = 0; i < nActive; i++) {
+            double* h = &st.vDecimator[vActiveList[i] * 2 * halfbandLength];
+            h[st.decimatorPosition] = h[st.decimatorPosition + halfbandLength] = vStageIn[i];
+        }
+        st.skip = !st.skip;
+        if (st.skip) return false;
+
+        for (int i = 0; i < nActive; i++) {
+            const double* x = &st.vDecimator[vActiveList[i] * 2 * halfbandLength + st.decimatorPosition];
+            double acc = 0.;
+            for (int t = 0; t < (int)vHalfbandTap.size(); t++) {
+                acc += vHalfbandCoeff[t] * x[vHalfbandTap[t]];
+            }
+            vStageIn[i] = acc;
+        }
+        return true;
+    }
+
+    void Transform(sStage& st) {
+        const int nActive = (int)vActiveList.size();
+        const int nBins = stageSize / 2 + 1;
+        const double norm = 2. / (S1 * S1);
+        for (int i = 0; i < nActive; i += 2) {
+            const double* a = &st.vHistory[vActiveList[i] * stageSize];
+            const double* b = (i + 1 < nActive) ? &st.vHistory[vActiveList[i + 1] * stageSize] : 0;
+            int h = st.position;
+            for (int n = 0; n < stageSize; n++) {
+                vScratch[n].re = (WDL_FFT_REAL)(a[h] * vWindowFx[n]);
+                vScratch[n].im = b ? (WDL_FFT_REAL)(b[h] * vWindowFx[n]) : 0.;
+                if (++h >= stageSize) h = 0;
+            }
+
+            WDL_fft(&vScratch[0], stageSize, false);
+
+            // A[k] = (Z[k] + conj(Z[N-k])) / 2,  B[k] = (Z[k] - conj(Z[N-k])) / 2j
+            double* outA = &st.vOutPut[vActiveList[i] * nBins];
+            double* outB = b ? &st.vOutPut[vActiveList[i + 1] * nBins] : 0;
+            for (int k = 1; k < nBins; k++) {
+                const WDL_FFT_COMPLEX& z = vScratch[vPermute[k]];
+                const WDL_FFT_COMPLEX& zc = vScratch[vPermute[stageSize - k]];
+                const double ar = 0.5 * (z.re + zc.re);
+                const double ai = 0.5 * (z.im - zc.im);
+                outA[k] = std::sqrt(norm * (ar * ar + ai * ai));
+                if (outB) {
+                    const double br = 0.5 * (z.im + zc.im);
+                    const double bi = 0.5 * (zc.re - z.re);
+                    outB[k] = std::sqrt(norm * (br * br + bi * bi));
+                }
+            }
+            // first bin is not shown
+            outA[0] = 0.;
+            if (outB) outB[0] = 0.;
+        }
+        frameCount++;
+    }
+
+    void CalculateWindowFx() {
+        vWindowFx.resize(stageSize);
+        Spect_FFT::FillWindow(vWindowFx, windowType);
+        S1 = 0.;
+        for (int i = 0; i < stageSize; i++) {
+            S1 += vWindowFx[i];
+        }
+    }
+
+    // Blackman windowed sinc with the cutoff at a quarter of the sample rate. Every other tap
+    // of a halfband filter is zero, so only the non-zero ones are stored.
+    void CalculateHalfband() {
+        const int center = halfbandLength / 2;
+        double sum = 0.;
+        vHalfbandTap.resize(0);
+        vHalfbandCoeff.resize(0);
+        for (int i = 0; i < halfbandLength; i++) {
+            const int d = i - center;
+            if (d != 0 && d % 2 == 0) continue;
+            const double sinc = (d == 0) ? 0.5 : std::sin(0.5 * pi * d) / (pi * d);
+            const double w = 0.42 - 0.5 * std::cos(pi2 * i / (halfbandLength - 1.)) + 0.08 * std::cos(pi4 * i / (halfbandLength - 1.));
+            vHalfbandTap.push_back(i);
+            vHalfbandCoeff.push_back(sinc * w);
+            sum += sinc * w;
+        }
+        for (int i = 0; i < (int)vHalfbandCoeff.size(); i++) {
+            vHalfbandCoeff[i] /= sum;
+        }
+    }
+
+    void CalculatePixelMap() {
+        const int nPixels = (int)vPixelFreq.size();
+        const int nBins = stageSize / 2;
+        vPixelMap.resize(nPixels);
+        for (int px = 0; px < nPixels; px++) {
+            const double f = vPixelFreq[px];
+
+            // most decimated stage whose (aliasing free) passband still holds this frequency
+            int stage = 0;
+            for (int k = (int)vStage.size() - 1; k > 0; k--) {
+                if (f <= halfbandPassband * sampleRate / (double)(1 << k)) {
+                    stage = k;
+                    break;
+                }
+            }
+            const double binHz = sampleRate / (double)(1 << stage) / (double)stageSize;
+
+            // the pixel covers the range halfway (in log frequency) to its neighbours
+            const double fLo = px > 0 ? std::sqrt(f * vPixelFreq[px - 1]) : f;
+            const double fHi = px < nPixels - 1 ? std::sqrt(f * vPixelFreq[px + 1]) : f;
+
+            sPixelMap& m = vPixelMap[px];
+            m.stage = stage;
+            m.binLo = BOUNDED((int)std::ceil(fLo / binHz), 1, nBins);
+            m.binHi = BOUNDED((int)std::floor(fHi / binHz), 1, nBins);
+            m.interpolate = m.binHi < m.binLo;
+            if (m.interpolate) {
+                const double pos = BOUNDED(f / binHz, 0., (double)nBins - 1.);
+                m.binLo = (int)pos;
+                m.frac = pos - m.binLo;
+            }
+        }
+    }
+
+    const int halfbandLength = 31;
+    const double halfbandPassband = 0.4; // fraction of a stage's sample rate
+
+    std::vector<sStage> vStage;
+    std::vector<WDL_FFT_COMPLEX> vScratch;
+    std::vector<double> vWindowFx;
+    std::vector<double> vStageIn;
+    std::vector<bool> vActive;
+    std::vector<int> vActiveList;
+    std::vector<int> vHalfbandTap;
+    std::vector<double> vHalfbandCoeff;
+    std::vector<double> vPixelFreq;
+    std::vector<sPixelMap> vPixelMap;
+    int* vPermute;
+    int stageSize, numStreams, windowType;
+    unsigned int frameCount = 0;
+    double sampleRate;
+    double S1;
+};
+
+// Runs the spectrum analysis off the audio thread. The audio thread writes the taps that are
+// switched on into the ring; Run() is polled from the GUI thread, drains the ring in one go and
+// analyzes all taps together, so all curves of a frame come from the same audio.
+// Settings may be changed from any thread, they are picked up on the next run.
+class Spect_AnalysisWorker {
+public:
+    Spect_AnalysisWorker(IPlugBase* pPlug, const int numtaps, const int fftsize, const int stagesize, const int numstages, const double samplerate)
+        : ring(numtaps, 1 << 14),
+          linear(pPlug, fftsize, 1, samplerate, numtaps),
+          multiRes(pPlug, stagesize, numstages, samplerate, numtaps)
+    {
+        numTaps = numtaps;
+        requestedTaps.store(1);
+        requestedMultiRes.store(false);
+        requestedSampleRate.store(samplerate);
+        viewed.store(false);
+        restart.store(false);
+        appliedTaps = 0;
+        appliedMultiRes = false;
+        appliedSampleRate = samplerate;
+        lastFrameCount = 0;
+        Apply();
+    }
+    ~Spect_AnalysisWorker() {}
+
+    Spect_TapRing* GetRing() { return &ring; }
+
+    // taps the audio thread should write, as a bit mask; none while nobody views them
+    unsigned int GetRequestedTaps() const {
+        return viewed.load(std::memory_order_relaxed) ? requestedTaps.load(std::memory_order_relaxed) : 0;
+    }
+
+    // editor opened or closed; on opening, whatever is left in the ring is dropped
+    // on the next run, so the first curves are of current audio
+    void SetViewed(const bool v) {
+        if (v) restart.store(true);
+        viewed.store(v);
+    }
+
+    void SetTaps(const unsigned int mask) { requestedTaps.store(mask); }
+    void SetMultiRes(const bool m) { requestedMultiRes.store(m); }
+    void SetSampleRate(const double sr) { requestedSampleRate.store(sr); }
+
+    void SetWindowType(const int type) {
+        linear.SetWindowType(type);
+        multiRes.SetWindowType(type);
+    }
+
+    void SetPixelFrequencies(const std::vector<double>& freqs) {
+        linear.SetPixelFrequencies(freqs);
+        multiRes.SetPixelFrequencies(freqs);
+    }
+
+    // GUI thread: analyzes everything the audio thread has written, returns true if new curves are ready
+    bool Run() {
+        if (restart.exchange(false) || requestedTaps.load() != appliedTaps || requestedMultiRes.load() != appliedMultiRes || requestedSampleRate.load() != appliedSampleRate) {
+            Apply();
+        }
+        Spect_MultiResFFT& fft = appliedMultiRes ? multiRes : linear;
+        const int n = ring.Available();
+        for (int i = 0; i < n; i++) {
+            fft.SendInput(ring.ReadFrame(i));
+        }
+        ring.Consume(n);
+
+        const bool isNew = fft.GetFrameCount() != lastFrameCount;
+        lastFrameCount = fft.GetFrameCount();
+        return isNew;
+    }
+
+    bool IsTapActive(const int tap) const { return (appliedTaps >> tap) & 1; }
+
+    double GetPixelOutput(const int px, const int tap) const {
+        return appliedMultiRes ? multiRes.GetPixelOutput(px, tap) : linear.GetPixelOutput(px, tap);
+    }
+
+private:
+    void Apply() {
+        appliedTaps = requestedTaps.load();
+        appliedMultiRes = requestedMultiRes.load();
+        appliedSampleRate = requestedSampleRate.load();
+        for (int t = 0; t < numTaps; t++) {
+            linear.SetStreamActive(t, IsTapActive(t));
+            multiRes.SetStreamActive(t, IsTapActive(t));
+        }
+        linear.SetSampleRate(appliedSampleRate);
+        multiRes.SetSampleRate(appliedSampleRate);
+        linear.ClearBuffers();
+        multiRes.ClearBuffers();
+        ring.Discard();
+    }
+
+    Spect_TapRing ring;
+    Spect_MultiResFFT linear, multiRes;
+    std::atomic<unsigned int> requestedTaps;
+    std::atomic<bool> requestedMultiRes;
+    std::atomic<double> requestedSampleRate;
+    std::atomic<bool> viewed, restart;
+    unsigned int appliedTaps, lastFrameCount;
+    bool appliedMultiRes;
+    double appliedSampleRate;
+    int numTaps;
+};
+
 class gFFTAnalyzer : public IControl
     {
     public:
+        enum EView { kViewLine = 0, kViewSpectrogram };
+
         gFFTAnalyzer(IPlugBase* pPlug, IRECT pR, IColor c, int par, int sz, bool l)
             : IControl(pPlug, pR), mColor(c), mColorBG(c), mParam(par), line(l)
         {
@@ -237,17 +637,34 @@ class gFFTAnalyzer : public IControl
             maxFreq = 44100. / 0.5;
             sampleRate = 44100.;
             width = static_cast<int>(mRECT.W());
+            rows = static_cast<int>(mRECT.H()) - 20;
             value.resize(sz / 2 + 1 );
-            iVal.resize(width);
-            iPeak.resize(width);
+            pixelFreq.resize(width);
+            pixelGain.resize(width);
+            rowFreq.resize(rows);
+            rowGain.resize(rows);
+            view = kViewLine;
+            requestedView.store(kViewLine);
+            active = true;
+            requestedActive.store(true);
+            spectrogram = 0;
+            spectrogramPos = 0;
+            colorLUT.resize(256);
+            source = 0;
+            tapColor.resize(1, mColor);
+            iVal.resize(1, std::vector<double>(width));
+            iPeak.resize(1, std::vector<double>(width));
             OctaveGain = 1.;
             ResetValuestoFloor();
             decayValue = 0.70;
             peakdecayValue = 0.95;
+            CalcPixelFreqs();
+            CalcColorLUT();
             }
 
         ~gFFTAnalyzer()
             {
+            delete spectrogram;
             }
         void SetdbFloor(const double f) { 
             ampFloor = DBToAmp(f);
@@ -255,13 +672,21 @@ class gFFTAnalyzer : public IControl
             ResetValuestoFloor();
         }
 
+        // line or spectrogram (kViewSpectrogram), may be called from any thread, applied on the next GUI tick
+        void SetView(const int v) { requestedView.store(v); }
+
+        // analysis on/off, an inactive analyzer clears once and is never dirty again until switched on
+        void SetActive(const bool a) { requestedActive.store(a); }
+
         void SetMinFreq(const double f) { 
             minFreq = BOUNDED(f, 1, maxFreq);
+            CalcPixelFreqs();
             ResetValuestoFloor();
          }
 
         void SetMaxFreq(const double f) {
             maxFreq = BOUNDED(f, minFreq, mPlug->GetSampleRate() * 0.5);
+            CalcPixelFreqs();
             ResetValuestoFloor();
         }
 
@@ -269,6 +694,7 @@ class gFFTAnalyzer : public IControl
         void SetOctaveGain(const double g, const bool isDB) {
             if (isDB) OctaveGain = DBToAmp(g);
             else OctaveGain = g;
+            CalcPixelFreqs();
         }
 
         void SendFFT(double v, int c, double sr)
@@ -277,60 +703,59 @@ class gFFTAnalyzer : public IControl
             sampleRate = sr;
             }
 
+        // Pull curves from an analysis worker instead of SendFFT(). The worker is run from here
+        // (GUI thread) and every active tap is drawn as its own curve; tap 0 gets the fill.
+        void SetSource(Spect_AnalysisWorker* w, const int numTaps) {
+            source = w;
+            source->SetPixelFrequencies(view == kViewSpectrogram ? rowFreq : pixelFreq);
+            tapColor.resize(numTaps, mColor);
+            iVal.resize(numTaps, std::vector<double>(width));
+            iPeak.resize(numTaps, std::vector<double>(width));
+            ResetValuestoFloor();
+        }
+
+        void SetTapColor(const int tap, IColor c) { tapColor[tap] = c; }
+
         bool Draw(IGraphics* pGraphics)
             {
                 
+            if (view == kViewSpectrogram && source) {
+                DrawSpectrogram(pGraphics);
+                return true;
+            }
+
             //Draw Background
             IRECT FreqRect(mRECT.L, mRECT.T, mRECT.R, mRECT.B-20);
             pGraphics->FillIRect(&mColorBG, &FreqRect);
                 
-            double x, y, yPeak;
-            double xPrev = mRECT.L;
-            double yPrev = mRECT.B;
-            double yPrevPeak = yPrev;
-            int startBin = 1;
-            const double mF = maxFreq / minFreq;
-            for (int f = 0; f < width; f++) {
-                const double FreqForBin = minFreq * std::pow(mF, (double)f / (double)(width-1));
-                bool isSearch = false;
-                while (!isSearch)
-                {
-                    const double b1 = BOUNDED((double)(startBin - 1) * sampleRate / fftBins, 0., sampleRate) ;
-                    const double b2 = BOUNDED((double)startBin * sampleRate / fftBins, 0., sampleRate);
-
-                    if(b1 <= FreqForBin && b2 >= FreqForBin ) {
-                        const double interpV = LinInterp(b1, value[startBin - 1], b2, value[startBin], FreqForBin);
-                        iVal[f] = std::max(interpV, iVal[f] * decayValue);
-                        iPeak[f] = std::max(interpV, iPeak[f] * peakdecayValue);
-                        startBin = std::max(startBin-2, 1);
-                        isSearch = true;
-                    }
-                    startBin++;
-                    if (startBin >= value.size()) isSearch = true;
+            if (source) {
+                for (int t = 0; t < (int)iVal.size(); t++) {
+                    if (source->IsTapActive(t)) DrawCurve(pGraphics, t);
                 }
             }
+            else {
+                int startBin = 1;
+                for (int f = 0; f < width; f++) {
+                    const double FreqForBin = pixelFreq[f];
+                    bool isSearch = false;
+                    while (!isSearch)
+                    {
+                        const double b1 = BOUNDED((double)(startBin - 1) * sampleRate / fftBins, 0., sampleRate) ;
+                        const double b2 = BOUNDED((double)startBin * sampleRate / fftBins, 0., sampleRate);
 
-            for (int b = 0; b < width; b++)
-            {
-                x = b + mRECT.L;
-                const double binFreq = minFreq * std::pow(mF, (double)b / (double)(width));
-                const double oct = std::log10(binFreq / minFreq) / 0.30102999;
-                const double gainO = std::pow(OctaveGain, oct);
-                
-                double dbv = AmpToDB(iVal[b] * gainO);
-                y = RangeConvert(BOUNDED(dbv, dBFloor, 0.), 0., (double)mRECT.T, dBFloor, (double)mRECT.B-20);
-                double pdv = AmpToDB(iPeak[b] * gainO);
-                yPeak = RangeConvert(BOUNDED(pdv, dBFloor, 0.), 0., (double)mRECT.T, dBFloor, (double)mRECT.B-20);
-
-                if (!line) pGraphics->DrawVerticalLine(&mColor2, x, mRECT.B-20, y);
-
-                if (b == 0) yPeak = yPrevPeak = y;
-
-                pGraphics->DrawLine(&mColor, xPrev, yPrevPeak, x, yPeak);
-                    xPrev = x;
-                    yPrev = y;
-                    yPrevPeak = yPeak;
+                        if(b1 <= FreqForBin && b2 >= FreqForBin ) {
+                            const double interpV = LinInterp(b1, value[startBin - 1], b2, value[startBin], FreqForBin);
+                            iVal[0][f] = std::max(interpV, iVal[0][f] * decayValue);
+                            iPeak[0][f] = std::max(interpV, iPeak[0][f] * peakdecayValue);
+                            startBin = std::max(startBin-2, 1);
+                            isSearch = true;
+                        }
+                        startBin++;
+                        if (startBin >= value.size()) isSearch = true;
+                    }
                 }
+                DrawCurve(pGraphics, 0);
+            }
                 
             pGraphics->DrawHorizontalLine(&mColorBG, mRECT.B-20, mRECT.L, mRECT.R);
 
@@ -342,27 +767,168 @@ class gFFTAnalyzer : public IControl
             mColor = peakLine;
             mColor2 = fill;
             mColorBG = background;
+            tapColor[0] = peakLine;
+            CalcColorLUT();
         }
 
-        bool IsDirty() { return true;}
+        // Only repaints when the worker has finished a new frame (or the view changed), so the redraw
+        // rate follows the analysis frame rate and an idle or switched off analyzer costs nothing.
+        bool IsDirty() {
+            bool dirty = mDirty;
+            if (requestedView.load() != view) {
+                ApplyView();
+                dirty = true;
+            }
+            const bool nowActive = requestedActive.load();
+            if (nowActive != active) {
+                active = nowActive;
+                ResetValuestoFloor();
+                dirty = true;
+            }
+            if (source && active && source->Run()) {
+                if (view == kViewSpectrogram) WriteSpectrogramColumn();
+                else UpdateCurves();
+                dirty = true;
+            }
+            return dirty;
+        }
 
         void ResetValuestoFloor() {
             const double ampF = 0.;
-            for (int f = 0; f < width; f++) {
-                iVal[f] = ampF;
-                iPeak[f] = ampF;
+            for (int t = 0; t < (int)iVal.size(); t++) {
+                std::fill(iVal[t].begin(), iVal[t].end(), ampF);
+                std::fill(iPeak[t].begin(), iPeak[t].end(), ampF);
             }
             for (std::vector<double>::iterator it = value.begin(); it != value.end(); ++it)
             {
                 *it = ampF;
             }
+            if (spectrogram) LICE_Clear(spectrogram, colorLUT[0]);
         }
 
     private:
+        // curves decay once per analysis frame, not per paint
+        void UpdateCurves() {
+            for (int t = 0; t < (int)iVal.size(); t++) {
+                if (!source->IsTapActive(t)) continue;
+                for (int f = 0; f < width; f++) {
+                    const double v = source->GetPixelOutput(f, t);
+                    iVal[t][f] = std::max(v, iVal[t][f] * decayValue);
+                    iPeak[t][f] = std::max(v, iPeak[t][f] * peakdecayValue);
+                }
+            }
+        }
+
+        void ApplyView() {
+            view = requestedView.load();
+            if (view == kViewSpectrogram && !spectrogram) spectrogram = new LICE_MemBitmap(width, rows);
+            spectrogramPos = 0;
+            if (source) source->SetPixelFrequencies(view == kViewSpectrogram ? rowFreq : pixelFreq);
+            ResetValuestoFloor();
+        }
+
+        // one column per analysis frame, written at the ring position; older columns are never touched again.
+        // Rows hold the loudest active tap, bottom row is minFreq.
+        void WriteSpectrogramColumn() {
+            LICE_pixel* bits = spectrogram->getBits();
+            const int span = spectrogram->getRowSpan();
+            const double lutScale = 255. / -dBFloor;
+            for (int r = 0; r < rows; r++) {
+                double v = 0.;
+                for (int t = 0; t < (int)iVal.size(); t++) {
+                    if (source->IsTapActive(t)) v = std::max(v, source->GetPixelOutput(r, t));
+                }
+                const double dbv = AmpToDB(std::max(v * rowGain[r], ampFloor));
+                const int c = BOUNDED((int)((dbv - dBFloor) * lutScale), 0, 255);
+                const int y = spectrogram->isFlipped() ? r : rows - 1 - r;
+                bits[y * span + spectrogramPos] = colorLUT[c];
+            }
+            if (++spectrogramPos >= width) spectrogramPos = 0;
+        }
+
+        // the ring is blitted in two parts so the column after the newest one lands on the left edge
+        void DrawSpectrogram(IGraphics* pGraphics) {
+            LICE_IBitmap* dst = pGraphics->GetDrawBitmap();
+            const int older = width - spectrogramPos;
+            LICE_Blit(dst, spectrogram, mRECT.L, mRECT.T, spectrogramPos, 0, older, rows, 1.f, LICE_BLIT_MODE_COPY);
+            LICE_Blit(dst, spectrogram, mRECT.L + older, mRECT.T, 0, 0, spectrogramPos, rows, 1.f, LICE_BLIT_MODE_COPY);
+            pGraphics->DrawHorizontalLine(&mColorBG, mRECT.B-20, mRECT.L, mRECT.R);
+        }
+
+        // background -> fill -> peak line color -> white over the dB range
+        void CalcColorLUT() {
+            const IColor* stops[4] = { &mColorBG, &mColor2, &mColor, &COLOR_WHITE };
+            const int n = (int)colorLUT.size();
+            for (int i = 0; i < n; i++) {
+                const double pos = 3. * (double)i / (double)(n - 1);
+                const int s = std::min((int)pos, 2);
+                const double frac = pos - s;
+                const IColor& a = *stops[s];
+                const IColor& b = *stops[s + 1];
+                colorLUT[i] = LICE_RGBA((int)(a.R + (b.R - a.R) * frac), (int)(a.G + (b.G - a.G) * frac), (int)(a.B + (b.B - a.B) * frac), 255);
+            }
+            if (spectrogram) LICE_Clear(spectrogram, colorLUT[0]);
+        }
+
+        void DrawCurve(IGraphics* pGraphics, const int t) {
+            double x, y, yPeak;
+            double xPrev = mRECT.L;
+            double yPrev = mRECT.B;
+            double yPrevPeak = yPrev;
+            for (int b = 0; b < width; b++)
+            {
+                x = b + mRECT.L;
+                const double gainO = pixelGain[b];
+
+                double dbv = AmpToDB(iVal[t][b] * gainO);
+                y = RangeConvert(BOUNDED(dbv, dBFloor, 0.), 0., (double)mRECT.T, dBFloor, (double)mRECT.B-20);
+                double pdv = AmpToDB(iPeak[t][b] * gainO);
+                yPeak = RangeConvert(BOUNDED(pdv, dBFloor, 0.), 0., (double)mRECT.T, dBFloor, (double)mRECT.B-20);
+
+                if (!line && t == 0) pGraphics->DrawVerticalLine(&mColor2, x, mRECT.B-20, y);
+
+                if (b == 0) yPeak = yPrevPeak = y;
+
+                pGraphics->DrawLine(&tapColor[t], xPrev, yPrevPeak, x, yPeak);
+                xPrev = x;
+                yPrev = y;
+                yPrevPeak = yPeak;
+            }
+        }
+
+        // pixel frequencies and their octave compensation only change with the display range
+        void CalcPixelFreqs() {
+            const double mF = maxFreq / minFreq;
+            for (int f = 0; f < width; f++) {
+                pixelFreq[f] = minFreq * std::pow(mF, (double)f / (double)(width-1));
+                const double binFreq = minFreq * std::pow(mF, (double)f / (double)(width));
+                const double oct = std::log10(binFreq / minFreq) / 0.30102999;
+                pixelGain[f] = std::pow(OctaveGain, oct);
+            }
+            for (int r = 0; r < rows; r++) {
+                rowFreq[r] = minFreq * std::pow(mF, (double)r / (double)(rows-1));
+                rowGain[r] = std::pow(OctaveGain, std::log10(rowFreq[r] / minFreq) / 0.30102999);
+            }
+            if (source) source->SetPixelFrequencies(view == kViewSpectrogram ? rowFreq : pixelFreq);
+        }
+
         int fftWidth, sCount, mParam, mScaleP;
         std::vector <double> value;
-        std::vector<double>iVal;
-        std::vector<double>iPeak;
+        std::vector<double>pixelFreq;
+        std::vector<double>pixelGain;
+        std::vector<double>rowFreq;
+        std::vector<double>rowGain;
+        std::vector<LICE_pixel>colorLUT;
+        LICE_MemBitmap* spectrogram;
+        int view, rows, spectrogramPos;
+        bool active;
+        //set from the audio thread's parameter changes, read on the GUI thread
+        std::atomic<int> requestedView;
+        std::atomic<bool> requestedActive;
+        std::vector<std::vector<double> >iVal;
+        std::vector<std::vector<double> >iPeak;
+        std::vector<IColor>tapColor;
+        Spect_AnalysisWorker* source;
         double val, fftBins, sampleRate;
         int i, width;
         double decayValue, peakdecayValue;
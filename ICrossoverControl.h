@@ -10,6 +10,7 @@
 #include "IControl.h"
 
 #include "IControl.h"
+#include "LinkwitzRiley.h"
 #include <vector>
 #include <algorithm>
 #include <sstream>
@@ -37,6 +38,23 @@ protected:
     int mParamIdx3;
     bool isDragging;
     
+    //labels are only rebuilt when a handle moves
+    IText mLabelText;
+    std::string mLabel[3];
+    IRECT mLabelRect[3];
+    
+    //band response curves: one magnitude table per crossover filter (lowpass/highpass), evaluated at
+    //every pixel frequency, and the curve y positions built from them. A moved handle only recomputes
+    //its two filters and the bands they feed.
+    bool mShowBands;
+    IColor mBandColor[4];
+    LinkwitzRiley mCurveFilter[3][2];
+    std::vector<double> mPixelFreq;
+    std::vector<double> mFilterMag[3][2];
+    std::vector<int> mBandY[4];
+    double mCurveSampleRate;
+    double mCurveFloor;
+    
     double percentToCoordinates(double value) {
         double min = (double) this->mRECT.L;
         double distance = (double) this->mRECT.W();
@@ -58,26 +76,62 @@ public:
         }
         mValue2=getFreq(2);
         mValue3=getFreq(3);
+        //handles are hit-tested in pR, the frequency labels below it are part of the drawn (dirty) area
+        mTargetRECT = pR;
+        mRECT.B = pR.B+22;
+        mLabelText = IText(12, &COLOR_WHITE, "Futura");
+        updateLabels();
+        
+        mShowBands = false;
+        mCurveSampleRate = 0;
+        mCurveFloor = -60.;
+        mPixelFreq.resize(mTargetRECT.W());
+        for (int px=0; px<(int)mPixelFreq.size(); px++) {
+            mPixelFreq[px] = minFreq * std::pow(maxFreq/minFreq, (double)px / (double)(mPixelFreq.size()-1));
+        }
+        for (int j=0; j<4; j++) {
+            mBandColor[j] = *mColor;
+            mBandY[j].resize(mTargetRECT.W());
+        }
+        for (int i=0; i<3; i++) {
+            mCurveFilter[i][Lowpass] = LinkwitzRiley(44100, Lowpass, getFreq(i+1));
+            mCurveFilter[i][Highpass] = LinkwitzRiley(44100, Highpass, getFreq(i+1));
+            mFilterMag[i][Lowpass].resize(mTargetRECT.W());
+            mFilterMag[i][Highpass].resize(mTargetRECT.W());
+        }
     };
     ~ICrossoverControl() {};
     
     bool Draw(IGraphics *pGraphics){
         if(!IsGrayed()){
-            int y = mRECT.T+mRECT.H()/2;
+            if (mShowBands) {
+                if (mCurveSampleRate != mPlug->GetSampleRate()) {
+                    mCurveSampleRate = mPlug->GetSampleRate();
+                    for (int i=0; i<3; i++) updateFilterCurves(i);
+                    updateBandCurves(15);
+                }
+                for (int j=0; j<4; j++) {
+                    for (int px=1; px<(int)mBandY[j].size(); px++) {
+                        pGraphics->DrawLine(&mBandColor[j], mTargetRECT.L+px-1, mBandY[j][px-1], mTargetRECT.L+px, mBandY[j][px]);
+                    }
+                }
+            }
+            
+            int y = mTargetRECT.T+mTargetRECT.H()/2;
             for (int i=0; i<3; i++) {
                 CrossoverHandle* current = &handles[i];
                 
                 
                 if(i==selected.uid-1){
-                    pGraphics->DrawVerticalLine(mColor3, percentToCoordinates(current->x), this->mRECT.B, y+4);
-                    pGraphics->DrawVerticalLine(mColor3, percentToCoordinates(current->x), y-4, this->mRECT.T);
+                    pGraphics->DrawVerticalLine(mColor3, percentToCoordinates(current->x), this->mTargetRECT.B, y+4);
+                    pGraphics->DrawVerticalLine(mColor3, percentToCoordinates(current->x), y-4, this->mTargetRECT.T);
                     
                     pGraphics->DrawCircle(mColor3, percentToCoordinates(current->x), y, 3);
                     pGraphics->DrawCircle(mColor3, percentToCoordinates(current->x), y, 4);
                 }
                 else{
-                    pGraphics->DrawVerticalLine(mColor, percentToCoordinates(current->x), this->mRECT.B, y+4);
-                    pGraphics->DrawVerticalLine(mColor, percentToCoordinates(current->x), y-4, this->mRECT.T);
+                    pGraphics->DrawVerticalLine(mColor, percentToCoordinates(current->x), this->mTargetRECT.B, y+4);
+                    pGraphics->DrawVerticalLine(mColor, percentToCoordinates(current->x), y-4, this->mTargetRECT.T);
                     
                     pGraphics->DrawCircle(mColor, percentToCoordinates(current->x), y, 3);
                     pGraphics->DrawCircle(mColor, percentToCoordinates(current->x), y, 4);
@@ -86,10 +140,7 @@ public:
                 //pGraphics->FillCircle(mColor2, percentToCoordinates(current->x), y, 2);
                 
                 
-                IText text = IText(12, &COLOR_WHITE, "Futura");
-                const char* str = (formatFreq(getFreq(i+1)));
-                IRECT textRect = IRECT(percentToCoordinates(current->x)-10, this->mRECT.B+2, percentToCoordinates(current->x)+10, this->mRECT.B+22);
-                pGraphics->DrawIText(&text, (char*)str, &textRect);
+                pGraphics->DrawIText(&mLabelText, (char*)mLabel[i].c_str(), &mLabelRect[i]);
             }
         }
         return true;
@@ -153,12 +204,21 @@ public:
             rightBound=handles[selected.uid].x;
         }
 
+        //sub-pixel moves change nothing on screen
+        if((int)percentToCoordinates(xPercent)==(int)percentToCoordinates(handles[selected.uid-1].x)) return;
+        
         if(xPercent<rightBound-.05 && xPercent>leftBound+.05){
             handles[selected.uid-1].x=xPercent;
             updateValues();
+            updateLabels();
+            if (mShowBands && mCurveSampleRate > 0) {
+                //band1 = LP1, band2 = HP1*LP3*LP2, band3 = HP1*LP3*HP2, band4 = HP1*HP3
+                static const int bandsUsing[3] = {15, 6, 14};
+                updateFilterCurves(selected.uid-1);
+                updateBandCurves(bandsUsing[selected.uid-1]);
+            }
+            SetDirty(true);
         }
-  
-        SetDirty(true);
     };
     
     
@@ -174,7 +234,53 @@ public:
         mValue3 = handles[2].x;
     }
     
-    const char* formatFreq(double freq){
+    //draws each band's magnitude response over the analyzer, dB range mCurveFloor..0
+    void ShowBandCurves(bool show, const IColor* colors = 0){
+        mShowBands = show;
+        if (colors) {
+            for (int j=0; j<4; j++) mBandColor[j] = colors[j];
+        }
+        mCurveSampleRate = 0;
+        SetDirty(false);
+    }
+    
+    void updateFilterCurves(int i){
+        const int w = (int)mPixelFreq.size();
+        for (int t=Lowpass; t<=Highpass; t++) {
+            LinkwitzRiley& f = mCurveFilter[i][t];
+            f.setSampleRate(mCurveSampleRate);
+            f.setCutoff(getFreq(i+1));
+            for (int px=0; px<w; px++) {
+                mFilterMag[i][t][px] = f.getMagnitude(mPixelFreq[px]);
+            }
+        }
+    }
+    
+    void updateBandCurves(int bandMask){
+        const int w = (int)mBandY[0].size();
+        for (int j=0; j<4; j++) {
+            if (!(bandMask & (1 << j))) continue;
+            for (int px=0; px<w; px++) {
+                double m;
+                if (j==0) m = mFilterMag[0][Lowpass][px];
+                else if (j==1) m = mFilterMag[0][Highpass][px] * mFilterMag[2][Lowpass][px] * mFilterMag[1][Lowpass][px];
+                else if (j==2) m = mFilterMag[0][Highpass][px] * mFilterMag[2][Lowpass][px] * mFilterMag[1][Highpass][px];
+                else m = mFilterMag[0][Highpass][px] * mFilterMag[2][Highpass][px];
+                const double db = BOUNDED(20.*log10(std::max(m, 1e-9)), mCurveFloor, 0.);
+                mBandY[j][px] = (int)(mTargetRECT.T + (mTargetRECT.B - mTargetRECT.T) * db / mCurveFloor);
+            }
+        }
+    }
+    
+    void updateLabels(){
+        for (int i=0; i<3; i++) {
+            const double x = percentToCoordinates(handles[i].x);
+            mLabel[i] = formatFreq(getFreq(i+1));
+            mLabelRect[i] = IRECT(x-10, this->mTargetRECT.B+2, x+10, this->mTargetRECT.B+22);
+        }
+    }
+    
+    std::string formatFreq(double freq){
         std::stringstream ss;
         ss << (int)freq;
         std::string val = ss.str();
@@ -189,7 +295,7 @@ public:
             out = val;
         }
         
-        return out.c_str();
+        return out;
     }
     
     
@@ -24,11 +24,6 @@ public:
         if(IsGrayed()){
             blend.mMethod=blend.kBlendColorDodge;
             blend.mWeight=.8;
-            mText = IText(14,&COLOR_GRAY,"Futura");
-        }
-        else{
-            mText = IText(14,&COLOR_WHITE,"Futura");
-            blend = IChannelBlend();
         }
 
         pGraphics->FillIRect(&mColor, &mRECT, &blend);
@@ -51,7 +46,14 @@ public:
             PromptUserInput(&mRECT);
         }
         
-        mPlug->GetGUI()->SetAllControlsDirty();
+        //only this menu changed, controls that depend on the parameter are updated through OnParamChange
+        SetDirty(false);
+    }
+    
+    void GrayOut(bool gray)
+    {
+        IControl::GrayOut(gray);
+        mText = IText(14, gray ? &COLOR_GRAY : &COLOR_WHITE, "Futura");
     }
     
 private:
@@ -9,6 +9,9 @@
 #ifndef LinkwitzRiley_h
 #define LinkwitzRiley_h
 
+#define _USE_MATH_DEFINES		// to use M_PI
+#include <cmath>
+
 enum FilterType {
     Lowpass = 0,
     Highpass,
@@ -16,6 +19,9 @@ enum FilterType {
 
 class LinkwitzRiley{
 public:
+    //  Channels with a state of their own
+    static const int maxChannels = 16;
+
     LinkwitzRiley(){
         sr = 44100;
         filterType = 0;
@@ -39,43 +45,114 @@ public:
     //  Process sample of audio
     double process(double sample, int channel){
         double tempx = sample;
-        double tempy = a0*tempx+a1*buffX[channel][0]+a2*buffX[channel][1]+a3*buffX[channel][2]+a4*buffX[channel][3]-b1*buffY[channel][0]-b2*buffY[channel][1]-b3*buffY[channel][2]-b4*buffY[channel][3];
+        double tempy = a0*tempx+a1*buffX[0][channel]+a2*buffX[1][channel]+a3*buffX[2][channel]+a4*buffX[3][channel]-b1*buffY[0][channel]-b2*buffY[1][channel]-b3*buffY[2][channel]-b4*buffY[3][channel];
         
-        buffX[channel][3]=buffX[channel][2];
-        buffX[channel][2]=buffX[channel][1];
-        buffX[channel][1]=buffX[channel][0];
-        buffX[channel][0]=tempx;
+        buffX[3][channel]=buffX[2][channel];
+        buffX[2][channel]=buffX[1][channel];
+        buffX[1][channel]=buffX[0][channel];
+        buffX[0][channel]=tempx;
         
-        buffY[channel][3]=buffY[channel][2];
-        buffY[channel][2]=buffY[channel][1];
-        buffY[channel][1]=buffY[channel][0];
-        buffY[channel][0]=tempy;
+        buffY[3][channel]=buffY[2][channel];
+        buffY[2][channel]=buffY[1][channel];
+        buffY[1][channel]=buffY[0][channel];
+        buffY[0][channel]=tempy;
         
         return tempy;
     }
     
+    //  Process one sample of each of the first nChannels channels, in place or not.
+    //  The state is stored by tap, then channel, so the channels sit next to each
+    //  other and advance together in SIMD lanes.
+    void processFrame(const double* in, double* out, int nChannels){
+        const double c0=a0, c1=a1, c2=a2, c3=a3, c4=a4, d1=b1, d2=b2, d3=b3, d4=b4;
+        double* x0=buffX[0]; double* x1=buffX[1]; double* x2=buffX[2]; double* x3=buffX[3];
+        double* y0=buffY[0]; double* y1=buffY[1]; double* y2=buffY[2]; double* y3=buffY[3];
+        
+        for (int c=0; c<nChannels; c++) {
+            double tempx = in[c];
+            double tempy = c0*tempx+c1*x0[c]+c2*x1[c]+c3*x2[c]+c4*x3[c]-d1*y0[c]-d2*y1[c]-d3*y2[c]-d4*y3[c];
+            
+            x3[c]=x2[c];
+            x2[c]=x1[c];
+            x1[c]=x0[c];
+            x0[c]=tempx;
+            
+            y3[c]=y2[c];
+            y2[c]=y1[c];
+            y1[c]=y0[c];
+            y0[c]=tempy;
+            
+            out[c]=tempy;
+        }
+    }
+    
+    //  True when no channel's state is above threshold: the filter has rung out
+    //  and, with silence in, would only put out values below it
+    bool isQuiet(double threshold) const {
+        for (int i=0; i<4; i++) {
+            for (int c=0; c<maxChannels; c++) {
+                if (std::fabs(buffX[i][c]) > threshold || std::fabs(buffY[i][c]) > threshold) return false;
+            }
+        }
+        return true;
+    }
+    
+    //  Clear the state of every channel
+    void reset(){
+        for (int i=0; i<4; i++) {
+            for (int c=0; c<maxChannels; c++) {
+                buffX[i][c]=0;
+                buffY[i][c]=0;
+            }
+        }
+    }
+    
     //  Set cutoff frequency (Hz)
     void setCutoff(double freq){
         fc = freq;
         calcFilter();
     }
     
+    //  Set sample rate (Hz)
+    void setSampleRate(double sampleRate){
+        sr = sampleRate;
+        calcFilter();
+    }
+    
+    //  Magnitude response at freq (Hz), evaluated from the current coefficients
+    double getMagnitude(double freq){
+        double w=2*M_PI*freq/sr;
+        double c=cos(w);
+        double s=sin(w);
+        
+        //  z^-k = e^-jkw for k=0..4
+        double re[5], im[5];
+        re[0]=1;
+        im[0]=0;
+        for (int k=1; k<5; k++) {
+            re[k]=re[k-1]*c+im[k-1]*s;
+            im[k]=im[k-1]*c-re[k-1]*s;
+        }
+        
+        double numRe=a0+a1*re[1]+a2*re[2]+a3*re[3]+a4*re[4];
+        double numIm=a1*im[1]+a2*im[2]+a3*im[3]+a4*im[4];
+        double denRe=1+b1*re[1]+b2*re[2]+b3*re[3]+b4*re[4];
+        double denIm=b1*im[1]+b2*im[2]+b3*im[3]+b4*im[4];
+        
+        return sqrt((numRe*numRe+numIm*numIm)/(denRe*denRe+denIm*denIm));
+    }
+    
 private:
     void calcFilter(){
         double wc, wc2, wc3, wc4, k, k2, k3, k4, sqrt2, sq_tmp1, sq_tmp2, a_tmp;
         
-        for (int i=0; i<4; i++) {
-            buffX[0][i]=0;
-            buffX[1][i]=0;
-            buffY[0][i]=0;
-            buffY[1][i]=0;
-        }
+        reset();
         
-        wc=2*pi*fc;
+        wc=2*M_PI*fc;
         wc2=wc*wc;
         wc3=wc2*wc;
         wc4=wc2*wc2;
-        k=wc/tan(pi*fc/sr);
+        k=wc/tan(M_PI*fc/sr);
         k2=k*k;
         k3=k2*k;
         k4=k2*k2;
@@ -116,9 +193,9 @@ private:
     //	Coefficients
     double a0, a1, a2, a3, a4, b1, b2, b3, b4;
     
-    //  Buffer
-    double buffX[2][4];
-    double buffY[2][4];
+    //  Buffer, [tap][channel]
+    double buffX[4][maxChannels];
+    double buffY[4][maxChannels];
 };
 
 #endif /* LinkwitzRiley_h */
@@ -3,6 +3,11 @@
 #include "IControl.h"
 #include "resource.h"
 #include "denormal.h"
+#include "RealtimeGuard.h"
+#ifdef PARALLEL_BANDS
+#include <algorithm>
+#include <thread>
+#endif
 
 const int kNumPrograms = 1;
 
@@ -40,15 +45,33 @@ enum EParams
   kCrossoverFreq1,
   kCrossoverFreq2,
   kCrossoverFreq3,
+  kSpectResolution,
+  kSpectOverlay,
+  kSpectView,
+  kOversampling1,
+  kOversampling2,
+  kOversampling3,
+  kOversampling4,
+  kFastShapers,
   kNumParams
 };
 
+enum EOverlay
+{
+  kOverlayOutput=0,
+  kOverlayInputOutput,
+  kOverlayBands,
+  kOverlayBandsDryWet,
+  kNumOverlays
+};
+
 enum ELayout
 {
   kWidth = GUI_WIDTH,
   kHeight = GUI_HEIGHT,
   
-  kNumModes=6,
+  kNumModes=7,
+  kNumOversamplings=5,
   
   kDriveY = 132,
   kDrive1X = 45,
@@ -64,27 +87,19 @@ enum ELayout
   kSpectBypassX = 27,
   kSpectBypassY = 22,
   
+  kSpectMenuW = 59,
+  kSpectMenuH = 17,
+  
   kLevelMeterFrames=31,
   kSliderFrames=33
 };
 
 MultibandDistortion::MultibandDistortion(IPlugInstanceInfo instanceInfo):
   IPLUG_CTOR(kNumParams, kNumPrograms, instanceInfo),
-  mInputGain(0.), mOutputGain(0.), mControlsLinked(false), mOversampling(8)
+  mInputGain(0.), mOutputGain(0.), mEngine(GetSampleRate()), mWorkerPool(0)
 {
   TRACE;
   
-  mAntiAlias.Calc(0.5 / (double)mOversampling);
-  mUpsample.Reset();
-  mDownsample.Reset();
-  
-  band1lp =  LinkwitzRiley(GetSampleRate(), Lowpass, 112);
-  band2hp =  LinkwitzRiley(GetSampleRate(), Highpass, 112);
-  band2lp =  LinkwitzRiley(GetSampleRate(), Lowpass, 637);
-  band3hp =  LinkwitzRiley(GetSampleRate(), Highpass, 637);
-  band3lp =  LinkwitzRiley(GetSampleRate(), Lowpass, 3600);
-  band4hp =  LinkwitzRiley(GetSampleRate(), Highpass, 3600);
-  
   allpass1 =  CFxRbjFilter();
   allpass1.calc_filter_coeffs(allpass, 1000, GetSampleRate(), .5, 0, false);
   allpass2 =  CFxRbjFilter();
@@ -94,12 +109,7 @@ MultibandDistortion::MultibandDistortion(IPlugInstanceInfo instanceInfo):
   
 
   for (int i=0; i<4; i++) {
-    mDriveSmoother[i] = CParamSmooth(5.0,GetSampleRate());
-    mOutputSmoother[i] = CParamSmooth(5.0,GetSampleRate());
     mMixSmoother[i] = CParamSmooth(5.0,GetSampleRate());
-    mPeakFollower[i] = new PeakFollower(GetSampleRate());
-   // rmsDry[i] = RMSFollower();
-   // rmsWet[i] = RMSFollower();
   }
   
   //======================================================================================================
@@ -120,6 +130,17 @@ MultibandDistortion::MultibandDistortion(IPlugInstanceInfo instanceInfo):
   GetParam(kOutputGain)->InitDouble("Output Gain", 0., -36., 36., 0.0001, "dB");
   GetParam(kOutputClipping)->InitBool("Output Clipping", false);
   GetParam(kSpectBypass)->InitBool("Analyzer On", true);
+  GetParam(kSpectResolution)->InitEnum("Analyzer Resolution", 1, 2);
+  GetParam(kSpectResolution)->SetDisplayText(0, "Linear");
+  GetParam(kSpectResolution)->SetDisplayText(1, "Multi-Res");
+  GetParam(kSpectOverlay)->InitEnum("Analyzer Overlay", kOverlayOutput, kNumOverlays);
+  GetParam(kSpectOverlay)->SetDisplayText(kOverlayOutput, "Output");
+  GetParam(kSpectOverlay)->SetDisplayText(kOverlayInputOutput, "In/Out");
+  GetParam(kSpectOverlay)->SetDisplayText(kOverlayBands, "Bands");
+  GetParam(kSpectOverlay)->SetDisplayText(kOverlayBandsDryWet, "Dry/Wet");
+  GetParam(kSpectView)->InitEnum("Analyzer View", gFFTAnalyzer::kViewLine, 2);
+  GetParam(kSpectView)->SetDisplayText(gFFTAnalyzer::kViewLine, "Line");
+  GetParam(kSpectView)->SetDisplayText(gFFTAnalyzer::kViewSpectrogram, "Spectrogram");
   GetParam(kControlsLinked)->InitBool("Link Distortion Modes", false);
   
   GetParam(kDrive1)->InitDouble("Band 1: Drive", -3., -3., 36., 0.0001, "dB");
@@ -156,6 +177,7 @@ MultibandDistortion::MultibandDistortion(IPlugInstanceInfo instanceInfo):
   GetParam(kDistMode1)->SetDisplayText(3, "Fold");
   GetParam(kDistMode1)->SetDisplayText(4, "Tanh");
   GetParam(kDistMode1)->SetDisplayText(5, "Soft");
+  GetParam(kDistMode1)->SetDisplayText(6, "Cheby");
   
   GetParam(kDistMode2)->InitEnum("Band 2: Mode", 0, kNumModes);
   GetParam(kDistMode2)->SetDisplayText(0, "Excite");
@@ -164,6 +186,7 @@ MultibandDistortion::MultibandDistortion(IPlugInstanceInfo instanceInfo):
   GetParam(kDistMode2)->SetDisplayText(3, "Fold");
   GetParam(kDistMode2)->SetDisplayText(4, "Tanh");
   GetParam(kDistMode2)->SetDisplayText(5, "Soft");
+  GetParam(kDistMode2)->SetDisplayText(6, "Cheby");
   
   GetParam(kDistMode3)->InitEnum("Band 3: Mode", 0, kNumModes);
   GetParam(kDistMode3)->SetDisplayText(0, "Excite");
@@ -172,6 +195,7 @@ MultibandDistortion::MultibandDistortion(IPlugInstanceInfo instanceInfo):
   GetParam(kDistMode3)->SetDisplayText(3, "Fold");
   GetParam(kDistMode3)->SetDisplayText(4, "Tanh");
   GetParam(kDistMode3)->SetDisplayText(5, "Soft");
+  GetParam(kDistMode3)->SetDisplayText(6, "Cheby");
   
   GetParam(kDistMode4)->InitEnum("Band 4: Mode", 0, kNumModes);
   GetParam(kDistMode4)->SetDisplayText(0, "Excite");
@@ -180,6 +204,23 @@ MultibandDistortion::MultibandDistortion(IPlugInstanceInfo instanceInfo):
   GetParam(kDistMode4)->SetDisplayText(3, "Fold");
   GetParam(kDistMode4)->SetDisplayText(4, "Tanh");
   GetParam(kDistMode4)->SetDisplayText(5, "Soft");
+  GetParam(kDistMode4)->SetDisplayText(6, "Cheby");
+
+  //Oversampling: Auto picks the factor from the band's top edge and drive
+  const char* oversamplingNames[4] = { "Band 1: Oversampling", "Band 2: Oversampling", "Band 3: Oversampling", "Band 4: Oversampling" };
+  for (int i=0; i<4; i++) {
+    GetParam(kOversampling1+i)->InitEnum(oversamplingNames[i], 1, kNumOversamplings);
+    GetParam(kOversampling1+i)->SetDisplayText(0, "Auto");
+    GetParam(kOversampling1+i)->SetDisplayText(1, "1x");
+    GetParam(kOversampling1+i)->SetDisplayText(2, "2x");
+    GetParam(kOversampling1+i)->SetDisplayText(3, "4x");
+    GetParam(kOversampling1+i)->SetDisplayText(4, "8x");
+  }
+
+  //Fast: Tanh, Sine and Fold from tables, within 3e-9 of the exact curves
+  GetParam(kFastShapers)->InitEnum("Waveshapers", 0, 2);
+  GetParam(kFastShapers)->SetDisplayText(0, "Exact");
+  GetParam(kFastShapers)->SetDisplayText(1, "Fast");
   
   //Bitmaps
   IBitmap slider = pGraphics->LoadIBitmap(SLIDER_ID, SLIDER_FN, kSliderFrames);
@@ -342,15 +383,36 @@ MultibandDistortion::MultibandDistortion(IPlugInstanceInfo instanceInfo):
   //setting +3dB/octave compensation to the fft display
   gAnalyzer->SetOctaveGain(3., true);
   
+  //analysis runs from the analyzer on the GUI thread, the audio thread only fills the tap ring
+  mAnalysis = new Spect_AnalysisWorker(this, kNumTaps, fftSize, multiResStageSize, multiResStages, GetSampleRate());
+  mAnalysis->SetWindowType(Spect_FFT::win_BlackmanHarris);
+  gAnalyzer->SetSource(mAnalysis, kNumTaps);
+  gAnalyzer->SetTapColor(kTapInput, LIGHTER_GRAY);
+  for (int j=0; j<4; j++) {
+    gAnalyzer->SetTapColor(kTapBand1Wet+j, BAND_COLOR[j]);
+    gAnalyzer->SetTapColor(kTapBand1Dry+j, IColor(110, BAND_COLOR[j].R, BAND_COLOR[j].G, BAND_COLOR[j].B));
+  }
+  
   
   //==================================================================================================================================
   
   //Initialize crossover control
   mCrossoverControl = new ICrossoverControl(this, IRECT(iView.L,iView.T,iView.R, iView.B-20), &LIGHTER_GRAY, &DARK_GRAY, &LIGHT_ORANGE, kCrossoverFreq1, kCrossoverFreq2, kCrossoverFreq3);
+  mCrossoverControl->ShowBandCurves(true, BAND_COLOR);
   pGraphics->AttachControl(mCrossoverControl);
   
   pGraphics->AttachControl(new ISwitchControl(this, kSpectBypassX, kSpectBypassY, kSpectBypass, &bypassSmall));
   
+  IRECT resolutionRect = IRECT(iView.R-kSpectMenuW-2, iView.T+2, iView.R-2, iView.T+2+kSpectMenuH);
+  mSpectResolution = new IPopUpMenuControl(this, resolutionRect, DARK_GRAY, LIGHT_GRAY, kSpectResolution);
+  pGraphics->AttachControl(mSpectResolution);
+  
+  IRECT overlayRect = IRECT(resolutionRect.L-kSpectMenuW-2, resolutionRect.T, resolutionRect.L-2, resolutionRect.B);
+  pGraphics->AttachControl(new IPopUpMenuControl(this, overlayRect, DARK_GRAY, LIGHT_GRAY, kSpectOverlay));
+  
+  IRECT viewRect = IRECT(overlayRect.L-kSpectMenuW-2, overlayRect.T, overlayRect.L-2, overlayRect.B);
+  pGraphics->AttachControl(new IPopUpMenuControl(this, viewRect, DARK_GRAY, LIGHT_GRAY, kSpectView));
+  
   
   AttachGraphics(pGraphics);
   
@@ -358,221 +420,63 @@ MultibandDistortion::MultibandDistortion(IPlugInstanceInfo instanceInfo):
   //MakePreset("preset 1", ... );
   MakeDefaultPreset((char *) "-", kNumPrograms);
   
-  
-  //initializing FFT class
-  sFFT = new Spect_FFT(this, fftSize, 2);
-  sFFT->SetWindowType(Spect_FFT::win_BlackmanHarris);
+#ifdef PARALLEL_BANDS
+  //Bands on up to 3 other cores, for single heavy instances; with more instances
+  //than cores the host's own threading does better
+  const int workers = std::min(3, (int)std::thread::hardware_concurrency() - 1);
+  if (workers > 0) {
+    mWorkerPool = new WorkerPool(workers);
+    mEngine.SetWorkerPool(mWorkerPool);
+  }
+#endif
+#ifdef MULTIRATE_BANDS
+  //Low bands decimated, for a fixed latency the host compensates
+  mEngine.SetMultirate(true);
+  SetLatency(mEngine.GetLatencySamples());
+#endif
   
   
   
 }
 
-MultibandDistortion::~MultibandDistortion(){};
+MultibandDistortion::~MultibandDistortion(){
+  delete mWorkerPool;
+  delete mAnalysis;
+};
 
+//The analyzer taps are only written while the editor shows them
+void MultibandDistortion::OnGUIOpen()
+{
+  mAnalysis->SetViewed(true);
+}
 
-double MultibandDistortion::ProcessDistortion(double sample, int distType)
+void MultibandDistortion::OnGUIClose()
 {
-  //for (int m; m<mOversampling; m++) {
-    // Upsample
-  //if (m > 0) sample = 0.;
-    //mUpsample.Process(sample, mAntiAlias.Coeffs());
-    //sample = (double)mOversampling * mUpsample.Output();
-  
-  
-    //Excite
-    //Soft asymmetrical clipping
-    if (distType==0) {
-      double threshold = 0.6;
-      if(sample>threshold)
-        sample = threshold + (sample - threshold) / (1 + pow(((sample - threshold)/(1 - threshold)), 2));
-      else if(sample >1)
-        sample=1;
-    }
-  
-    //Fat
-    //arctan waveshaper
-    else if(distType==1){
-      sample =  1/2. * fastAtan(sample * 2);
-    }
-    
-    //Sine shaper
-    //based on Jon Watte's waveshaper algorithm. Modified for softer clipping
-    else if(distType==2){
-      double amount = 3.;
-      double z = M_PI * amount/4.0;
-      double s = 1/sin(z);
-      double b = 1 / amount;
-      
-      if (sample>b)
-        sample = sample + (1-sample)*0.8;
-      else if (sample < - b)
-        sample = sample + (-1-sample)*0.8;
-      else
-        sample = sin(z * sample) * s;
-      
-      sample *= pow(10, -amount/20.0);
-    }
-    
-    //Foldback Distortion
-    //algorithm by hellfire@upb.de, from musicdsp.org archives
-    else if(distType==3){
-      double threshold = .6;
-      if (sample > threshold || sample < - threshold)
-        sample = fabs(fabs(fmod(sample - threshold, threshold * 4)) - threshold * 2) - threshold;
-      
-    }
-    
-    //Tanh Waveshaper
-    else if (distType==4){
-      sample=1/3. * tanh(sample * 3.);
-    }
-    
-    //soft saturation
-    // from "A perceptual approach on clipping and saturation" by Stefania Barbati and Thomas Serafini for simulanalog.org
-    else if (distType==5){
-      if(sample>=1)
-        sample = .5;
-      else if(sample<1 && sample >= 0)
-        sample = -.5 * sample * sample + sample;
-      else if(sample<0 && sample > -1)
-        sample = .5 * sample * sample + sample;
-      else
-        sample = -.5;
-    }
-      //Downsample
-    //  mDownsample.Process(sample, mAntiAlias.Coeffs());
-      //if (m == 0) sample = mDownsample.Output();
-    //}
-  return sample;
+  mAnalysis->SetViewed(false);
 }
 
+
 /**
  This is the main loop where we'll process our samples
  */
 void MultibandDistortion::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
   // Mutex is already locked for us.
-  
-  
-  for (int i = 0; i < channelCount; i++) {
-    double* input = inputs[i];
-    double* output = outputs[i];
-    
-    for (int s = 0; s < nFrames; ++s, ++input, ++output) {
-      double sample = *input;
-      
-      
-      
-      //Apply input gain
-      sample *= DBToAmp(mInputGainSmoother.process(mInputGain)); //parameter smoothing prevents popping when changing parameter value
-      
-      if (mControlsLinked) {
-        double drySample = sample;
-        //Pre gain
-        sample *= DBToAmp(mDriveSmoother[0].process(mDrive[0])/1.5);
-        
-        //Distortion
-        sample = ProcessDistortion(sample, mDistMode[0]);
-        
-        //Gain comp
-        sample *= DBToAmp(mOutputSmoother[0].process(-.7 * mDrive[0])/1.5);
-        
-        //sample *= rmsDry[0].getRMS(drySample, i) / rmsWet[0].getRMS(sample, i);
-        
-        //Mix
-        sample = mMix[0] * sample + (1-mMix[0]) * drySample;
-        
-        //Update level meters
-        if (GetGUI()) {
-          mLevelMeter[0]->SetValueFromPlug(log10(mPeakFollower[0]->process(sample))+1);
-          mLevelMeter[1]->SetValueFromPlug(0);
-          mLevelMeter[2]->SetValueFromPlug(0);
-          mLevelMeter[3]->SetValueFromPlug(0);
-        }
-      }
-  
-      else{
-        //Filterbank
-        samplesFilteredDry[0]=band1lp.process(sample,i);
-        samplesFilteredDry[1]=band2hp.process(sample, i);
-        samplesFilteredDry[3]=band4hp.process(samplesFilteredDry[1], i);
-        samplesFilteredDry[1]=band3lp.process(samplesFilteredDry[1],i);
-        samplesFilteredDry[2]=band3hp.process(samplesFilteredDry[1],i);
-        samplesFilteredDry[1]=band2lp.process(samplesFilteredDry[1],i);
-        
-        
-        //Loop through bands, process samples
-        for (int j=0; j<4; j++) {
-          if (mMute[j]||WDL_DENORMAL_OR_ZERO_DOUBLE_AGGRESSIVE(&samplesFilteredDry[j])) {
-            samplesFilteredWet[j]=0;
-          }
-          else {
-            samplesFilteredWet[j]=samplesFilteredDry[j];
-            if (mEnable[j]) {
-              samplesFilteredWet[j]*=DBToAmp(mDriveSmoother[j].process(mDrive[j]));
-              
-              //Distortion
-              samplesFilteredWet[j]=ProcessDistortion(samplesFilteredWet[j], mDistMode[j]);
-              
-              
-              //Gain comp
-              samplesFilteredWet[j] *= DBToAmp(mOutputSmoother[j].process(-.7 * mDrive[j]));
-              
-              //samplesFilteredWet[j] *= rmsDry[j].getRMS(samplesFilteredDry[j], i) / rmsWet[j].getRMS(samplesFilteredWet[j], i);
-              
-              //Mix
-              samplesFilteredWet[j]= mMix[j]*samplesFilteredWet[j]+(1-mMix[j])*samplesFilteredDry[j];
-              
-              //Update level meters
-              if (GetGUI()) {
-                mLevelMeter[j]->SetValueFromPlug(log10(mPeakFollower[j]->process(samplesFilteredWet[j]))+1);
-              }
-              
-            }
-          }
-          
-          
-        }
-
-
-        
-        //Sum output
-        sample=0;
-        for(int j=0; j<4; j++){
-          if (mSolo[j]) {
-            sample=samplesFilteredWet[j];
-            break;
-          }
-          else{
-            sample+=samplesFilteredWet[j];
-          }
-        }
-      }//End multiband processing block
-      
-      //Clipping
-      if(mOutputClipping){
-        if (sample>1) {
-          sample = DBToAmp(-0.1);
-        }
-        else if (sample<-1) {
-          sample = -1*DBToAmp(-0.1);
-        }
-      }
-      
-      
-      
-      
-      if(mSpectBypass) sFFT->SendInput(sample);
-      
-      
-      *output = sample;
-    }
-  }
-  
-  if (GetGUI() && mSpectBypass) {
-    const double sr = this->GetSampleRate();
-    for (int c = 0; c < fftSize / 2 + 1; c++) {
-      gAnalyzer->SendFFT(sFFT->GetOutput(c), c, sr);
+  RealtimeScope realtime;
+  
+  //Analyzer taps nobody is looking at are not written, none while the editor is closed
+  mEngine.SetTaps(mAnalysis->GetRing(), mSpectBypass ? mAnalysis->GetRequestedTaps() : 0);
+  //Every connected channel, mono up to 16 channel surround
+  int nChannels = NOutChannels();
+  while (nChannels > 1 && !IsOutChannelConnected(nChannels-1)) nChannels--;
+  mEngine.ProcessBlock(inputs, outputs, nChannels, nFrames);
+  
+  //Meters are handed to the GUI once per block, snapped to the bitmap frames so they
+  //are only marked dirty when the visible frame changes
+  if (GetGUI()) {
+    for (int j=0; j<4; j++) {
+      const double frame = floor(BOUNDED(mEngine.GetMeterLevel(j), 0., 1.) * (kLevelMeterFrames-1) + 0.5);
+      mLevelMeter[j]->SetValueFromPlug(frame / (kLevelMeterFrames-1));
     }
   }
 }
@@ -581,6 +485,12 @@ void MultibandDistortion::Reset()
 {
   TRACE;
   IMutexLock lock(this);
+  
+  mEngine.SetSampleRate(GetSampleRate());
+  mAnalysis->SetSampleRate(GetSampleRate());
+  //how long the output rings on after the input stops, for hosts that stop
+  //processing on silence
+  SetTailSize(mEngine.GetTailSamples());
 }
 
 
@@ -593,6 +503,7 @@ void MultibandDistortion::OnParamChange(int paramIdx)
   {
     case kInputGain:
       mInputGain = GetParam(kInputGain)->Value();
+      mEngine.SetInputGain(mInputGain);
       break;
       
     case kOutputGain:
@@ -600,60 +511,60 @@ void MultibandDistortion::OnParamChange(int paramIdx)
       break;
       
     case kOutputClipping:
-      mOutputClipping = GetParam(kOutputClipping)->Value();
+      mEngine.SetOutputClipping(GetParam(kOutputClipping)->Value());
       break;
       
     case kDrive1:
-      mDrive[0]=GetParam(kDrive1)->Value();
+      mEngine.SetDrive(0, GetParam(kDrive1)->Value());
       break;
       
     case kDrive2:
-      mDrive[1]=GetParam(kDrive2)->Value();
+      mEngine.SetDrive(1, GetParam(kDrive2)->Value());
       break;
       
     case kDrive3:
-      mDrive[2]=GetParam(kDrive3)->Value();
+      mEngine.SetDrive(2, GetParam(kDrive3)->Value());
       break;
       
     case kDrive4:
-      mDrive[3]=GetParam(kDrive4)->Value();
+      mEngine.SetDrive(3, GetParam(kDrive4)->Value());
       break;
       
     case kMix1:
-      mMix[0]=GetParam(kMix1)->Value()/100.;
+      mEngine.SetMix(0, GetParam(kMix1)->Value()/100.);
       break;
       
     case kMix2:
-      mMix[1]=GetParam(kMix2)->Value()/100.;
+      mEngine.SetMix(1, GetParam(kMix2)->Value()/100.);
       break;
       
     case kMix3:
-      mMix[2]=GetParam(kMix3)->Value()/100.;
+      mEngine.SetMix(2, GetParam(kMix3)->Value()/100.);
       break;
       
     case kMix4:
-      mMix[3]=GetParam(kMix4)->Value()/ 100.;
+      mEngine.SetMix(3, GetParam(kMix4)->Value()/100.);
       break;
       
     case kBand1Enable:
-      mEnable[0]=GetParam(kBand1Enable)->Value();
+      mEngine.SetEnable(0, GetParam(kBand1Enable)->Value());
       break;
       
     case kBand2Enable:
-      mEnable[1]=GetParam(kBand2Enable)->Value();
+      mEngine.SetEnable(1, GetParam(kBand2Enable)->Value());
       break;
       
     case kBand3Enable:
-      mEnable[2]=GetParam(kBand3Enable)->Value();
+      mEngine.SetEnable(2, GetParam(kBand3Enable)->Value());
       break;
       
     case kBand4Enable:
-      mEnable[3]=GetParam(kBand4Enable)->Value();
+      mEngine.SetEnable(3, GetParam(kBand4Enable)->Value());
       break;
       
     case kControlsLinked:
-      mControlsLinked=GetParam(kControlsLinked)->Value();
-      if (mControlsLinked) {
+      mEngine.SetLinked(GetParam(kControlsLinked)->Value());
+      if (GetParam(kControlsLinked)->Value()) {
         mDistMode2->GrayOut(true);
         mDistMode3->GrayOut(true);
         mDistMode4->GrayOut(true);
@@ -714,28 +625,41 @@ void MultibandDistortion::OnParamChange(int paramIdx)
       break;
       
     case kDistMode1:
-      mDistMode[0]=GetParam(kDistMode1)->Value();
+      mEngine.SetMode(0, GetParam(kDistMode1)->Value());
       break;
       
     case kDistMode2:
-      mDistMode[1]=GetParam(kDistMode2)->Value();
+      mEngine.SetMode(1, GetParam(kDistMode2)->Value());
       break;
       
     case kDistMode3:
-      mDistMode[2]=GetParam(kDistMode3)->Value();
+      mEngine.SetMode(2, GetParam(kDistMode3)->Value());
       break;
       
     case kDistMode4:
-      mDistMode[3]=GetParam(kDistMode4)->Value();
+      mEngine.SetMode(3, GetParam(kDistMode4)->Value());
       break;
       
     case kSpectBypass:
       mSpectBypass=GetParam(kSpectBypass)->Value();
+      gAnalyzer->SetActive(mSpectBypass);
+      break;
+      
+    case kSpectResolution:
+      mAnalysis->SetMultiRes(GetParam(kSpectResolution)->Value());
+      break;
+      
+    case kSpectOverlay:
+      mAnalysis->SetTaps(overlayTaps(GetParam(kSpectOverlay)->Int()));
+      break;
+      
+    case kSpectView:
+      gAnalyzer->SetView(GetParam(kSpectView)->Int());
       break;
       
     case kSolo1:
-      mSolo[0]=GetParam(kSolo1)->Value();
-      if(mSolo[0]){
+      mEngine.SetSolo(0, GetParam(kSolo1)->Value());
+      if(GetParam(kSolo1)->Value()){
 
 
         this->SetParameterFromGUI(kSolo2, 0);
@@ -752,8 +676,8 @@ void MultibandDistortion::OnParamChange(int paramIdx)
       break;
       
     case kSolo2:
-      mSolo[1]=GetParam(kSolo2)->Value();
-      if(mSolo[1]){
+      mEngine.SetSolo(1, GetParam(kSolo2)->Value());
+      if(GetParam(kSolo2)->Value()){
         this->SetParameterFromGUI(kSolo1, 0);
         this->SetParameterFromGUI(kSolo3, 0);
         this->SetParameterFromGUI(kSolo4, 0);
@@ -768,8 +692,8 @@ void MultibandDistortion::OnParamChange(int paramIdx)
       break;
       
     case kSolo3:
-      mSolo[2]=GetParam(kSolo3)->Value();
-      if(mSolo[2]){
+      mEngine.SetSolo(2, GetParam(kSolo3)->Value());
+      if(GetParam(kSolo3)->Value()){
 
 
         this->SetParameterFromGUI(kSolo1, 0);
@@ -786,8 +710,8 @@ void MultibandDistortion::OnParamChange(int paramIdx)
       break;
       
     case kSolo4:
-      mSolo[3]=GetParam(kSolo4)->Value();
-      if(mSolo[3]){
+      mEngine.SetSolo(3, GetParam(kSolo4)->Value());
+      if(GetParam(kSolo4)->Value()){
 
         
         this->SetParameterFromGUI(kSolo1, 0);
@@ -804,37 +728,51 @@ void MultibandDistortion::OnParamChange(int paramIdx)
       break;
       
     case kMute1:
-      mMute[0]=GetParam(kMute1)->Value();
+      mEngine.SetMute(0, GetParam(kMute1)->Value());
       break;
       
     case kMute2:
-      mMute[1]=GetParam(kMute2)->Value();
+      mEngine.SetMute(1, GetParam(kMute2)->Value());
       break;
       
     case kMute3:
-      mMute[2]=GetParam(kMute3)->Value();
+      mEngine.SetMute(2, GetParam(kMute3)->Value());
       break;
       
     case kMute4:
-      mMute[3]=GetParam(kMute4)->Value();
+      mEngine.SetMute(3, GetParam(kMute4)->Value());
       break;
       
     case kCrossoverFreq1:
-      mCrossoverFreq1=percentToFreq(GetParam(kCrossoverFreq1)->Value());
-      band1lp.setCutoff(mCrossoverFreq1);
-      band2hp.setCutoff(mCrossoverFreq1);
+      mEngine.SetCrossover(0, percentToFreq(GetParam(kCrossoverFreq1)->Value()));
+      SetTailSize(mEngine.GetTailSamples());
       break;
       
     case kCrossoverFreq2:
-      mCrossoverFreq2=percentToFreq(GetParam(kCrossoverFreq2)->Value());
-      band2lp.setCutoff(mCrossoverFreq2);
-      band3hp.setCutoff(mCrossoverFreq2);
+      mEngine.SetCrossover(1, percentToFreq(GetParam(kCrossoverFreq2)->Value()));
+      SetTailSize(mEngine.GetTailSamples());
       break;
       
     case kCrossoverFreq3:
-      mCrossoverFreq3=percentToFreq(GetParam(kCrossoverFreq3)->Value());
-      band3lp.setCutoff(mCrossoverFreq3);
-      band4hp.setCutoff(mCrossoverFreq3);
+      mEngine.SetCrossover(2, percentToFreq(GetParam(kCrossoverFreq3)->Value()));
+      SetTailSize(mEngine.GetTailSamples());
+      break;
+      
+    case kOversampling1:
+    case kOversampling2:
+    case kOversampling3:
+    case kOversampling4:
+    {
+      //Auto, 1x, 2x, 4x, 8x; oversampling delays every band alike, for the host to compensate
+      const int setting = GetParam(paramIdx)->Int();
+      mEngine.SetOversampling(paramIdx - kOversampling1, setting ? 1 << (setting - 1) : 0);
+      SetLatency(mEngine.GetLatencySamples());
+      SetTailSize(mEngine.GetTailSamples());
+      break;
+    }
+      
+    case kFastShapers:
+      mEngine.SetFastShapers(GetParam(kFastShapers)->Int() == 1);
       break;
       
     default:
@@ -842,6 +780,17 @@ void MultibandDistortion::OnParamChange(int paramIdx)
   }
 }
 
+unsigned int MultibandDistortion::overlayTaps(int overlay){
+  unsigned int taps = 0;
+  if (overlay == kOverlayOutput || overlay == kOverlayInputOutput) taps |= 1 << kTapOutput;
+  if (overlay == kOverlayInputOutput) taps |= 1 << kTapInput;
+  for (int j=0; j<4; j++) {
+    if (overlay == kOverlayBands || overlay == kOverlayBandsDryWet) taps |= 1 << (kTapBand1Wet+j);
+    if (overlay == kOverlayBandsDryWet) taps |= 1 << (kTapBand1Dry+j);
+  }
+  return taps;
+}
+
 double MultibandDistortion::percentToFreq(double p){
   const double minFreq = 20;
   const double maxFreq = 20000;
@@ -850,6 +799,3 @@ double MultibandDistortion::percentToFreq(double p){
 
 }
 
-double MultibandDistortion::fastAtan(double x){
-  return (x / (1.0 + 0.28 * (x * x)));
-}
\ No newline at end of file
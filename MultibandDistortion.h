@@ -10,10 +10,7 @@
 #include "LinkwitzRiley.h"
 #include "CFxRbjFilter.h"
 #include "PeakFollower.h"
-
-#define WDL_BESSEL_FILTER_ORDER 8
-#define WDL_BESSEL_DENORMAL_AGGRESSIVE
-#include "besselfilter.h"
+#include "MultibandEngine.h"
 
 class MultibandDistortion : public IPlug
 {
@@ -23,22 +20,21 @@ public:
 
   void Reset();
   void OnParamChange(int paramIdx);
+  void OnGUIOpen();
+  void OnGUIClose();
   void ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames);
-  double ProcessDistortion(double sample, int distType);
   
 private:
   void smoothFilters();
-  double fastAtan(double x);
   double percentToFreq(double p);
+  unsigned int overlayTaps(int overlay);
 
-  Spect_FFT* sFFT;
+  Spect_AnalysisWorker* mAnalysis;
   gFFTAnalyzer* gAnalyzer;
   gFFTFreqDraw* gFreqLines;
   CParamSmooth mInputGainSmoother;
   CParamSmooth mOutputGainSmoother;
   
-  CParamSmooth mDriveSmoother[4];
-  CParamSmooth mOutputSmoother[4];
   CParamSmooth mMixSmoother[4];
   
   CParamSmooth mCrossoverSmoother1 = CParamSmooth(5.0,GetSampleRate());
@@ -63,6 +59,7 @@ private:
   IPopUpMenuControl* mDistMode2;
   IPopUpMenuControl* mDistMode3;
   IPopUpMenuControl* mDistMode4;
+  IPopUpMenuControl* mSpectResolution;
 
 
 
@@ -80,7 +77,6 @@ private:
   
   IBitmapControl* mLevelMeter[4];
   
-  PeakFollower* mPeakFollower[4];
 
   
   //Set Colors
@@ -91,50 +87,27 @@ private:
   IColor LIGHT_ORANGE = IColor(255,245,187,0);
   IColor DARK_ORANGE = IColor(255,236,159,5);
   IColor TRANSP_ORANGE = IColor(255,245*.22,187*.22,0);
+  IColor BAND_COLOR[4] = {IColor(255,245,187,0), IColor(255,90,170,230), IColor(255,120,200,90), IColor(255,220,90,120)};
   
   
-  LinkwitzRiley band1lp;
-  LinkwitzRiley band2hp;
-  LinkwitzRiley band2lp;
-  LinkwitzRiley band3hp;
-  LinkwitzRiley band3lp;
-  LinkwitzRiley band4hp;
-  
   CFxRbjFilter allpass1;
   CFxRbjFilter allpass2;
   CFxRbjFilter allpass3;
 
-  WDL_BesselFilterCoeffs mAntiAlias;
-  WDL_BesselFilterStage mUpsample, mDownsample;
-  
-  double samplesFilteredDry[4];
-  double samplesFilteredWet[4];
-  double chebyshev[8];
   double mInputGain;
   double mOutputGain;
   double RMSDry, RMSWet;
 
-  RMSFollower rmsDry[4];
-  RMSFollower rmsWet[4];
 
-  double mCrossoverFreq1;
-  double mCrossoverFreq2;
-  double mCrossoverFreq3;
   
   const int fftSize=4096;
-  const int channelCount = 2;
+  const int multiResStageSize=512;
+  const int multiResStages=7;
   
-  const int mOversampling;
+  MultibandEngine mEngine;
+  WorkerPool* mWorkerPool;
 
-  double mDrive[4];
-  double mMix[4];
-  int mDistMode[4];
-  bool mMute[4];
-  bool mSolo[4];
-  bool mEnable[4];
-  
-  bool mControlsLinked;
-  bool mOutputClipping;
+  
   bool mSpectBypass;
 
 };
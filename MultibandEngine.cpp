@@ -0,0 +1,1265 @@
+//
+//  MultibandEngine.cpp
+//  MultibandDistortion
+//
+
+#include "MultibandEngine.h"
+#include "Distortion.h"
+#include "denormal.h"
+#include "RealtimeGuard.h"
+#include "DenormalGuard.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ENGINE_SSE2
+#endif
+
+static inline double DBToAmp(double dB) { return exp(0.11512925464970228 * dB); }
+static inline float DBToAmp(float dB) { return expf(0.115129255f * dB); }
+
+//Input and filter state below this (-160 dBFS) count as silence
+static const double kSilenceThreshold = 1e-8;
+
+//A decimated band's rate keeps this many times its top crossover, 16 harmonics
+//below Nyquist. The crossover filter is 96 dB down at the new Nyquist.
+static const double kMultirateHeadroom = 32.;
+
+//Below this the band's saving does not pay for its interpolation
+static const int kMinRateFactor = 4;
+
+//Length of the crossfades between linked and multiband controls and between modes
+static const double kFadeMs = 10.;
+
+//Crossover periods the filterbank takes to ring out from full scale at the
+//highest input gain, +36 dB, to kSilenceThreshold
+static const double kTailPeriods = 6.;
+
+#if !DENORMALS_FLUSHED_IN_HARDWARE
+static inline bool DenormalOrZero(const double* x) { return WDL_DENORMAL_OR_ZERO_DOUBLE_AGGRESSIVE(x); }
+static inline bool DenormalOrZero(const float* x) { return WDL_DENORMAL_OR_ZERO_FLOAT_AGGRESSIVE(x); }
+#endif
+
+//Largest magnitude in a block
+template <typename T>
+static inline T BlockPeak(const T* x, int n)
+{
+  T peak = 0;
+  for (int i=0; i<n; i++) {
+    const T a = std::fabs(x[i]);
+    peak = a > peak ? a : peak;
+  }
+  return peak;
+}
+
+#ifdef ENGINE_SSE2
+//The same in SSE2 lanes, the compiler does not vectorize max reductions without
+//-ffast-math. The sign bit is masked off for the magnitude.
+static inline double BlockPeak(const double* x, int n)
+{
+  const __m128d magnitude = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+  __m128d peak0 = _mm_setzero_pd(), peak1 = _mm_setzero_pd();
+  int i = 0;
+  for (; i+4<=n; i+=4) {
+    peak0 = _mm_max_pd(peak0, _mm_and_pd(_mm_loadu_pd(x+i), magnitude));
+    peak1 = _mm_max_pd(peak1, _mm_and_pd(_mm_loadu_pd(x+i+2), magnitude));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_max_pd(peak0, peak1));
+  const double peak = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+  const double rest = BlockPeak<double>(x+i, n-i);
+  return rest > peak ? rest : peak;
+}
+
+static inline float BlockPeak(const float* x, int n)
+{
+  const __m128 magnitude = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+  __m128 peak0 = _mm_setzero_ps(), peak1 = _mm_setzero_ps();
+  int i = 0;
+  for (; i+8<=n; i+=8) {
+    peak0 = _mm_max_ps(peak0, _mm_and_ps(_mm_loadu_ps(x+i), magnitude));
+    peak1 = _mm_max_ps(peak1, _mm_and_ps(_mm_loadu_ps(x+i+4), magnitude));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, _mm_max_ps(peak0, peak1));
+  float peak = lanes[0];
+  for (int l=1; l<4; l++) peak = lanes[l] > peak ? lanes[l] : peak;
+  const float rest = BlockPeak<float>(x+i, n-i);
+  return rest > peak ? rest : peak;
+}
+#endif
+
+template <typename T>
+MultibandEngineT<T>::MultibandEngineT(double sampleRate):
+  mTapRing(0), mTaps(0), mWorkerPool(0), mParallelMinFrames(0), mChunkChannels(0), mChunkFrames(0), mMultirate(false), mLatency(0), mLowLength(0), mHostDelayPos(0), mLinkedDelayPos(0), mHandOffPos(0), mOversamplingOn(false), mSharedBands(0), mSharedFactor(0), mLinkedChebyshevOrder(0), mLinkedOrderFrom(0), mFadeLength(1), mFadesPrimed(false), mLinkedRun(false), mLinkFade(0), mActiveBands(15), mSplitBands(15), mSampleRate(0.), mInputGain(0.), mControlsLinked(false), mOutputClipping(false), mSilenceSkip(true), mFastShapers(false)
+{
+  mCrossoverFreq[0] = 112;
+  mCrossoverFreq[1] = 637;
+  mCrossoverFreq[2] = 3600;
+
+  for (int i=0; i<4; i++) {
+    mPeakFollower[i] = 0;
+    mDrive[i] = -3.;
+    mMix[i] = 1.;
+    mDistMode[i] = 0;
+    mMute[i] = false;
+    mSolo[i] = false;
+    mEnable[i] = true;
+    mMeterLevel[i] = 0;
+    mModeRun[i] = mModeFrom[i] = 0;
+    mModeFade[i] = 0;
+    mRateFactor[i] = 1;
+    mRatePhase[i] = mLowPos[i] = mLowDelay[i] = 0;
+    mBandInterpolator[i] = 0;
+    mOversampling[i] = 1;
+    mShapedGain[i] = 0;
+    mChebyshevOrder[i] = mOrderFrom[i] = 0;
+    for (int c=0; c<kMaxChannels; c++) {
+      samplesFilteredDry[i][c] = 0;
+      samplesFilteredWet[i][c] = 0;
+    }
+  }
+
+  //the shared tables are built here rather than on the audio thread
+  WaveshaperTablesT<T>::Get();
+
+  SetSampleRate(sampleRate);
+}
+
+template <typename T>
+MultibandEngineT<T>::~MultibandEngineT()
+{
+  for (int i=0; i<4; i++) {
+    delete mPeakFollower[i];
+  }
+}
+
+template <typename T>
+void MultibandEngineT<T>::SetSampleRate(double sampleRate)
+{
+  mSampleRate = sampleRate;
+
+  band1lp =  LinkwitzRiley(mSampleRate, Lowpass, mCrossoverFreq[0]);
+  band2hp =  LinkwitzRiley(mSampleRate, Highpass, mCrossoverFreq[0]);
+  band2lp =  LinkwitzRiley(mSampleRate, Lowpass, mCrossoverFreq[1]);
+  band3hp =  LinkwitzRiley(mSampleRate, Highpass, mCrossoverFreq[1]);
+  band3lp =  LinkwitzRiley(mSampleRate, Lowpass, mCrossoverFreq[2]);
+  band4hp =  LinkwitzRiley(mSampleRate, Highpass, mCrossoverFreq[2]);
+
+  mInputGainSmoother = CParamSmooth(5.0,mSampleRate);
+  mLinkedDriveSmoother = CParamSmooth(5.0,mSampleRate);
+  mLinkedOutputSmoother = CParamSmooth(5.0,mSampleRate);
+  for (int i=0; i<4; i++) {
+    mDriveSmoother[i] = CParamSmooth(5.0,mSampleRate);
+    mOutputSmoother[i] = CParamSmooth(5.0,mSampleRate);
+    delete mPeakFollower[i];
+    mPeakFollower[i] = new PeakFollower(mSampleRate);
+  }
+
+  mFadeLength = (int)(kFadeMs * 0.001 * mSampleRate + 0.5);
+  if (mFadeLength < 1) mFadeLength = 1;
+  mFadeCurve.resize(mFadeLength + 1);
+  for (int i=0; i<=mFadeLength; i++) mFadeCurve[i] = sin(0.5 * M_PI * i / mFadeLength);
+  mFadesPrimed = false;
+  mLinkFade = 0;
+  for (int i=0; i<4; i++) mModeFade[i] = 0;
+  //the orders follow the new rate from the next block, without a fade
+  for (int i=0; i<4; i++) mChebyshevOrder[i] = 0;
+  mLinkedChebyshevOrder = 0;
+
+  //from the host rate smoothers above to the bands' rates
+  for (int i=0; i<4; i++) mRateFactor[i] = 1;
+  UpdateRateFactors();
+  for (int i=0; i<4; i++) ClearMultirate(i);
+  std::fill(mHostDelay.begin(), mHostDelay.end(), (T)0);
+  std::fill(mHandOff.begin(), mHandOff.end(), (T)0);
+  std::fill(mLinkedDelay.begin(), mLinkedDelay.end(), (T)0);
+  mHostDelayPos = mHandOffPos = mLinkedDelayPos = 0;
+  for (int i=0; i<4; i++) mOversampler[i].Reset();
+  mLinkedOversampler.Reset();
+  mSumDecimator.Reset();
+}
+
+//Interpolator for the multirate bands: passband to 0.35 of the low rate, images
+//from 0.65 down by about 60 dB
+static void DesignInterpolator(int taps, int factor, std::vector<double>& h)
+{
+  DesignPolyphaseSinc(taps, factor, 0.35 / factor, 5.65, h);
+}
+
+template <typename T>
+void MultibandEngineT<T>::SetMultirate(bool multirate)
+{
+  mMultirate = multirate;
+  if (multirate) {
+    std::vector<double> h;
+    for (int i=1; (1 << i) <= kMaxRateFactor; i++) {
+      DesignInterpolator(kInterpolatorTaps, 1 << i, h);
+      mInterpolator[i].assign(h.begin(), h.end());
+    }
+    //the most a band's interpolation can be delayed by is at the smallest factor
+    mLatency = kInterpolatorTaps * kMaxRateFactor / 2;
+    //room for the oversamplers' latency too, whenever they come on
+    mLowLength = kPhaseTaps + (mLatency - kInterpolatorTaps * kMinRateFactor / 2 + Oversampler::kLatency) / kMinRateFactor;
+    for (int j=0; j<4; j++) mLowHistory[j].assign(2 * mLowLength * kMaxChannels, (T)0);
+    mHostDelay.assign((mLatency + 1) * kMaxChannels, (T)0);
+    mLinkedDelay.assign((mLatency + 1) * kMaxChannels, (T)0);
+    //the longest a band plays on after a hand off, a decimated one at the largest factor
+    mHandOff.assign((mLatency + Oversampler::kLatency + (kPhaseTaps + 1) * kMaxRateFactor + 1) * kMaxChannels, (T)0);
+  }
+  else {
+    mLatency = mLowLength = 0;
+    for (int i=0; i<5; i++) std::vector<T>().swap(mInterpolator[i]);
+    for (int j=0; j<4; j++) std::vector<T>().swap(mLowHistory[j]);
+    std::vector<T>().swap(mHostDelay);
+    std::vector<T>().swap(mLinkedDelay);
+    std::vector<T>().swap(mHandOff);
+  }
+  mHostDelayPos = mHandOffPos = mLinkedDelayPos = 0;
+  UpdateRateFactors();
+  for (int j=0; j<4; j++) ClearMultirate(j);
+}
+
+//Band j's rate from its top crossover; the top band always runs at the host rate.
+//A band whose factor changes restarts its path from silence; with handOff, for a
+//crossover move, its old path plays out what it holds first, so nothing drops out.
+template <typename T>
+void MultibandEngineT<T>::UpdateRateFactors(bool handOff)
+{
+  for (int j=0; j<4; j++) {
+    int factor = 1;
+    if (mMultirate && j < 3) {
+      while (factor < kMaxRateFactor && mSampleRate / (2 * factor) >= kMultirateHeadroom * mCrossoverFreq[j]) factor *= 2;
+    }
+    if (factor < kMinRateFactor) factor = 1;
+    //the interpolator delays by half its length, the history makes up the rest,
+    //including the oversamplers' latency the host rate bands have
+    const int latency = mLatency + (mOversamplingOn ? Oversampler::kLatency : 0);
+    const int delay = factor > 1 ? (latency - kInterpolatorTaps * factor / 2) / factor : 0;
+    if (factor != mRateFactor[j]) {
+      if (handOff && !mHandOff.empty()) HandOffMultirate(j);
+      //the band's smoothers run at its rate, on from where they are
+      mDriveSmoother[j].setSamplingRate(5.0, mSampleRate / factor);
+      mOutputSmoother[j].setSamplingRate(5.0, mSampleRate / factor);
+      //an oversampler coming back into use holds frames from when it stopped
+      mOversampler[j].Reset();
+    }
+    if (factor != mRateFactor[j] || delay != mLowDelay[j]) {
+      mRateFactor[j] = factor;
+      mLowDelay[j] = delay;
+      ClearMultirate(j);
+    }
+    int shift = 0;
+    while ((1 << shift) < factor) shift++;
+    mBandInterpolator[j] = shift ? &mInterpolator[shift][0] : 0;
+  }
+}
+
+//Band j's old path played out into mHandOff, before its factor changes: a
+//decimated band interpolates on over silence until nothing from before is left
+//in reach, a host rate band on its own oversampler is run on silence for the
+//frames that holds back (the frames before are in mHostDelay already). Its new
+//path then starts with the frames from the move on, where the old one stops.
+template <typename T>
+void MultibandEngineT<T>::HandOffMultirate(int j)
+{
+  const int frames = (int)(mHandOff.size() / kMaxChannels);
+  T wet[kMaxChannels];
+  if (mRateFactor[j] == 1) {
+    if (!mOversamplingOn || (mSharedBands & (1u << j))) return;
+    const T silence[kMaxChannels] = { 0 };
+    for (int d=0; d<Oversampler::kLatency; d++) {
+      ProcessBand(j, silence, wet, kMaxChannels);
+      T* out = &mHandOff[((mHandOffPos + mLatency + d) % frames) * kMaxChannels];
+      for (int c=0; c<kMaxChannels; c++) out[c] += wet[c];
+    }
+    return;
+  }
+
+  const int length = (mLowDelay[j] + kPhaseTaps + 1) * mRateFactor[j];
+  for (int d=0; d<length; d++) {
+    if (mRatePhase[j] == 0) {
+      if (++mLowPos[j] == mLowLength) mLowPos[j] = 0;
+      std::fill_n(&mLowHistory[j][(mLowPos[j] + mLowLength) * kMaxChannels], kMaxChannels, (T)0);
+      std::fill_n(&mLowHistory[j][mLowPos[j] * kMaxChannels], kMaxChannels, (T)0);
+    }
+    InterpolateBand(j, wet, kMaxChannels);
+    T* out = &mHandOff[((mHandOffPos + d) % frames) * kMaxChannels];
+    for (int c=0; c<kMaxChannels; c++) out[c] += wet[c];
+  }
+}
+
+template <typename T>
+void MultibandEngineT<T>::ClearMultirate(int j)
+{
+  mRatePhase[j] = 0;
+  mLowPos[j] = 0;
+  std::fill(mLowHistory[j].begin(), mLowHistory[j].end(), (T)0);
+}
+
+template <typename T>
+void MultibandEngineT<T>::SetCrossover(int crossover, double freq)
+{
+  mCrossoverFreq[crossover] = freq;
+  switch (crossover) {
+    case 0:
+      band1lp.setCutoff(freq);
+      band2hp.setCutoff(freq);
+      break;
+
+    case 1:
+      band2lp.setCutoff(freq);
+      band3hp.setCutoff(freq);
+      break;
+
+    default:
+      band3lp.setCutoff(freq);
+      band4hp.setCutoff(freq);
+      break;
+  }
+  UpdateRateFactors(true);
+}
+
+template <typename T>
+int MultibandEngineT<T>::GetTailSamples() const
+{
+  double lowest = mCrossoverFreq[0];
+  for (int i=1; i<3; i++) {
+    if (mCrossoverFreq[i] < lowest) lowest = mCrossoverFreq[i];
+  }
+  return (int)ceil(kTailPeriods * mSampleRate / lowest) + GetLatencySamples();
+}
+
+template <typename T>
+void MultibandEngineT<T>::SetOversampling(int band, int factor)
+{
+  mOversampling[band] = factor;
+  bool on = false;
+  for (int j=0; j<4; j++) {
+    if (mOversampling[j] != 1) on = true;
+  }
+  if (on == mOversamplingOn) return;
+
+  //the latency changes: every path starts over from silence
+  mOversamplingOn = on;
+  for (int j=0; j<4; j++) mOversampler[j].Reset();
+  mLinkedOversampler.Reset();
+  mSumDecimator.Reset();
+  mSharedBands = 0;
+  mSharedFactor = 0;
+  std::fill(mHostDelay.begin(), mHostDelay.end(), (T)0);
+  std::fill(mHandOff.begin(), mHandOff.end(), (T)0);
+  std::fill(mLinkedDelay.begin(), mLinkedDelay.end(), (T)0);
+  mHostDelayPos = mHandOffPos = mLinkedDelayPos = 0;
+  UpdateRateFactors();
+  for (int j=0; j<4; j++) ClearMultirate(j);
+}
+
+//Enough oversampling for the harmonics drive brings up from a band whose top
+//edge is edge Hz: three of them, and one more for every 4 dB of drive
+template <typename T>
+int MultibandEngineT<T>::AutoOversampling(double edge, double dB) const
+{
+  const double harmonics = 3. + (dB > 0 ? dB / 4. : 0.);
+  int factor = 1;
+  while (factor < Oversampler::kMaxFactor && harmonics * edge > 0.5 * factor * mSampleRate) factor *= 2;
+  return factor;
+}
+
+//The Chebyshev mode's order for a band whose top edge is edge Hz, shaped at
+//rate Hz: as high as it goes without passing Nyquist. Below 3 the mode leaves
+//the band unshaped, which is what keeps it from aliasing there.
+template <typename T>
+int MultibandEngineT<T>::ChebyshevOrder(double edge, double rate) const
+{
+  int order = 1;
+  while (order < kMaxChebyshevOrder && (order + 1) * edge <= 0.5 * rate) order++;
+  return order;
+}
+
+//Each shaper's factor for this block, from its setting or from the band's edge
+//and drive, its Chebyshev order at that rate, and whether the bands shaped can
+//share a decimator. Needs mActiveBands.
+template <typename T>
+void MultibandEngineT<T>::UpdateOversampling(int nChannels, bool shareable)
+{
+  if (!mOversamplingOn) {
+    for (int j=0; j<4; j++) {
+      const double edge = j < 3 ? mCrossoverFreq[j] : 0.5 * mSampleRate;
+      SetChebyshevOrder(j, ChebyshevOrder(edge, mSampleRate / mRateFactor[j]));
+    }
+    SetChebyshevOrder(-1, ChebyshevOrder(0.5 * mSampleRate, mSampleRate));
+    return;
+  }
+
+  unsigned int shaped = 0;
+  int common = 0;
+  for (int j=0; j<4; j++) {
+    //a decimated band is only delayed
+    const double edge = j < 3 ? mCrossoverFreq[j] : 0.5 * mSampleRate;
+    int factor = 1;
+    if (mRateFactor[j] == 1) factor = mOversampling[j] ? mOversampling[j] : AutoOversampling(edge, mDrive[j]);
+    SetChebyshevOrder(j, ChebyshevOrder(edge, mSampleRate * factor / mRateFactor[j]));
+    //the rebuilt history carries the band's gain, as the frames after it will
+    mOversampler[j].SetFactor(factor, nChannels, [this, j](T* x, int n) {
+      ShapeBand(j, x, n, mChebyshevOrder[j], mOrderFrom[j]);
+      for (int c=0; c<n; c++) x[c] *= mShapedGain[j];
+    });
+
+    if (factor == 1 || !(mActiveBands & (1u << j)) || !mEnable[j]) continue;
+    if (common && factor != common) shareable = false;
+    common = factor;
+    shaped |= 1u << j;
+  }
+
+  const int linked = mOversampling[0] ? mOversampling[0] : AutoOversampling(0.5 * mSampleRate, mDrive[0] / 1.5);
+  SetChebyshevOrder(-1, ChebyshevOrder(0.5 * mSampleRate, mSampleRate * linked));
+  mLinkedOversampler.SetFactor(linked, nChannels, [this](T* x, int n) { ShapeBand(0, x, n, mLinkedChebyshevOrder, mLinkedOrderFrom); });
+
+  //the analyzer's band taps need every band decimated on its own, one band saves nothing
+  if (mTapRing && (mTaps & (15u << kTapBand1Wet))) shareable = false;
+  if (!shareable || (shaped & (shaped - 1)) == 0) {
+    mSharedBands = 0;
+    mSharedFactor = 0;
+    return;
+  }
+
+  //taking over from the bands' own decimators, or from another set of bands
+  if (shaped != mSharedBands || common != mSharedFactor) {
+    const Oversampler* sources[4];
+    int count = 0;
+    for (int j=0; j<4; j++) {
+      if (shaped & (1u << j)) sources[count++] = &mOversampler[j];
+    }
+    mSumDecimator.Rebuild(common, sources, count, nChannels);
+    mSharedBands = shaped;
+    mSharedFactor = common;
+  }
+}
+
+template <typename T>
+T MultibandEngineT<T>::ProcessDistortion(T sample, int distType)
+{
+  //Waveshapers live in Distortion.h, oversampling in Oversampler.h
+  return ::ProcessDistortion(sample, distType);
+}
+
+//Bands that reach the output: the first soloed one, or all that are not muted
+template <typename T>
+unsigned int MultibandEngineT<T>::ActiveBands() const
+{
+  for (int j=0; j<4; j++) {
+    if (mSolo[j]) return mMute[j] ? 0 : 1u << j;
+  }
+  unsigned int bands = 0;
+  for (int j=0; j<4; j++) {
+    if (!mMute[j]) bands |= 1u << j;
+  }
+  return bands;
+}
+
+//Crossover filters each band is split off by, as bits in the order of SplitFrame
+enum { kBand1lp = 1, kBand2hp = 2, kBand4hp = 4, kBand3lp = 8, kBand3hp = 16, kBand2lp = 32 };
+
+static unsigned int SplitFilters(unsigned int bands)
+{
+  static const unsigned int filters[4] = { kBand1lp, kBand2hp|kBand3lp|kBand2lp, kBand2hp|kBand3lp|kBand3hp, kBand2hp|kBand4hp };
+  unsigned int used = 0;
+  for (int j=0; j<4; j++) {
+    if (bands & (1u << j)) used |= filters[j];
+  }
+  return used;
+}
+
+//Filters that were left out hold the state of when they stopped, they are reset
+//rather than resumed from there
+template <typename T>
+void MultibandEngineT<T>::SetSplitBands(unsigned int bands)
+{
+  if (bands == mSplitBands) return;
+  const unsigned int resumed = SplitFilters(bands) & ~SplitFilters(mSplitBands);
+  if (resumed & kBand1lp) band1lp.reset();
+  if (resumed & kBand2hp) band2hp.reset();
+  if (resumed & kBand4hp) band4hp.reset();
+  if (resumed & kBand3lp) band3lp.reset();
+  if (resumed & kBand3hp) band3hp.reset();
+  if (resumed & kBand2lp) band2lp.reset();
+  for (int j=0; j<4; j++) {
+    if (!(bands & (1u << j))) {
+      for (int c=0; c<kMaxChannels; c++) samplesFilteredDry[j][c] = 0;
+    }
+  }
+  mSplitBands = bands;
+}
+
+//Filterbank: samplesFilteredDry[][] from the input gained frame, in double for either
+//sample type. Bands outside mSplitBands are left at zero, with the filters only they need.
+template <typename T>
+inline void MultibandEngineT<T>::SplitFrame(const T* frame, int nChannels)
+{
+  const unsigned int bands = mSplitBands;
+  //zeroed: the compiler cannot see that the filters read no channel past nChannels
+  double in[kMaxChannels] = { 0. }, high[kMaxChannels], band[kMaxChannels];
+  for (int c=0; c<nChannels; c++) in[c] = frame[c];
+
+  if (bands & 1) {
+    band1lp.processFrame(in, band, nChannels);
+    for (int c=0; c<nChannels; c++) samplesFilteredDry[0][c] = (T)band[c];
+  }
+  if (!(bands & 14)) return;
+  band2hp.processFrame(in, high, nChannels);
+  if (bands & 8) {
+    band4hp.processFrame(high, band, nChannels);
+    for (int c=0; c<nChannels; c++) samplesFilteredDry[3][c] = (T)band[c];
+  }
+  if (!(bands & 6)) return;
+  band3lp.processFrame(high, high, nChannels);
+  if (bands & 4) {
+    band3hp.processFrame(high, band, nChannels);
+    for (int c=0; c<nChannels; c++) samplesFilteredDry[2][c] = (T)band[c];
+  }
+  if (bands & 2) {
+    band2lp.processFrame(high, band, nChannels);
+    for (int c=0; c<nChannels; c++) samplesFilteredDry[1][c] = (T)band[c];
+  }
+}
+
+//Starts a crossfade for every change since the last block
+template <typename T>
+void MultibandEngineT<T>::UpdateFades()
+{
+  if (!mFadesPrimed) {
+    mLinkedRun = mControlsLinked;
+    for (int j=0; j<4; j++) mModeRun[j] = mDistMode[j];
+    mFadesPrimed = true;
+    return;
+  }
+
+  //turned back mid fade: from where it is, the other way
+  if (mControlsLinked != mLinkedRun) {
+    //a path coming in from rest does not replay what its delays held when it stopped
+    if (!mLinkFade) {
+      if (mControlsLinked) {
+        std::fill(mLinkedDelay.begin(), mLinkedDelay.end(), (T)0);
+        mLinkedDelayPos = 0;
+      }
+      else {
+        for (int j=0; j<4; j++) ClearMultirate(j);
+        std::fill(mHostDelay.begin(), mHostDelay.end(), (T)0);
+        std::fill(mHandOff.begin(), mHandOff.end(), (T)0);
+        mHostDelayPos = mHandOffPos = 0;
+      }
+    }
+    mLinkedRun = mControlsLinked;
+    mLinkFade = mFadeLength - mLinkFade;
+  }
+  for (int j=0; j<4; j++) {
+    if (mDistMode[j] == mModeRun[j]) continue;
+    //turned back mid fade to the mode and orders faded from: from where it is, the other way
+    const bool orders = mOrderFrom[j] == mChebyshevOrder[j] && (j || mLinkedOrderFrom == mLinkedChebyshevOrder);
+    if (mModeFade[j] && mDistMode[j] == mModeFrom[j] && orders) {
+      mModeFrom[j] = mModeRun[j];
+      mModeRun[j] = mDistMode[j];
+      mModeFade[j] = mFadeLength - mModeFade[j];
+    }
+    //any other change waits for the fade running to finish, so no side drops out
+    else if (!mModeFade[j]) {
+      StartModeFade(j);
+      mModeRun[j] = mDistMode[j];
+    }
+  }
+}
+
+//Band j's crossfade from what it runs now: its mode and Chebyshev order, and
+//for band 0 the linked path's order, as the linked path shares its fade
+template <typename T>
+void MultibandEngineT<T>::StartModeFade(int j)
+{
+  mModeFrom[j] = mModeRun[j];
+  mOrderFrom[j] = mChebyshevOrder[j];
+  if (j == 0) mLinkedOrderFrom = mLinkedChebyshevOrder;
+  mModeFade[j] = mFadeLength;
+}
+
+//Band j's Chebyshev order, or the linked path's for j < 0. A change where the
+//curve is heard is crossfaded, as a change of mode is, rather than stepping
+//the level near zero; the side being faded out keeps the order it had, and a
+//fade started this block already has it. Mid fade the change waits, as a
+//mode change does, and is made by a later block's call.
+template <typename T>
+void MultibandEngineT<T>::SetChebyshevOrder(int j, int order)
+{
+  const int band = j < 0 ? 0 : j;
+  int& current = j < 0 ? mLinkedChebyshevOrder : mChebyshevOrder[j];
+  if (order == current) return;
+  if (current && mModeRun[band] == DistChebyshev && mModeFade[band] != mFadeLength) {
+    if (mModeFade[band]) return;
+    StartModeFade(band);
+  }
+  current = order;
+}
+
+template <typename T>
+inline void MultibandEngineT<T>::AdvanceModeFades()
+{
+  for (int j=0; j<4; j++) {
+    if (mModeFade[j] > 0) mModeFade[j]--;
+  }
+}
+
+//One mode's waveshaper, the Chebyshev one up to order
+template <typename T>
+static inline void ShapeMode(T* x, int nChannels, int mode, int order, bool fast)
+{
+  if (mode == DistChebyshev) ProcessChebyshev(x, nChannels, order);
+  else if (fast) ProcessDistortionFast(x, nChannels, mode);
+  else ::ProcessDistortion(x, nChannels, mode);
+}
+
+//Band j's waveshaper, or the crossfade from its last mode and order while that runs
+template <typename T>
+inline void MultibandEngineT<T>::ShapeBand(int j, T* x, int nChannels, int order, int fromOrder)
+{
+  if (!mModeFade[j]) {
+    ShapeMode(x, nChannels, mModeRun[j], order, mFastShapers);
+    return;
+  }
+
+  const int k = mFadeLength - mModeFade[j];
+  const T fadeIn = (T)mFadeCurve[k + 1], fadeOut = (T)mFadeCurve[mFadeLength - k - 1];
+  T from[kMaxChannels];
+  for (int c=0; c<nChannels; c++) from[c] = x[c];
+  ShapeMode(from, nChannels, mModeFrom[j], fromOrder, mFastShapers);
+  ShapeMode(x, nChannels, mModeRun[j], order, mFastShapers);
+  for (int c=0; c<nChannels; c++) x[c] = fadeOut * from[c] + fadeIn * x[c];
+}
+
+//One band of a frame: wet from dry
+template <typename T>
+inline void MultibandEngineT<T>::ProcessBand(int j, const T* dry, T* wet, int nChannels)
+{
+  //muted, or another band is soloed
+  if (!(mActiveBands & (1u << j))) {
+    for (int c=0; c<nChannels; c++) wet[c] = 0;
+    mOversampler[j].Reset();
+    //the meter falls with the band's silent output rather than holding its last level
+    UpdateMeter(j, 0);
+    return;
+  }
+
+  //Under a FlushDenormalsScope denormal samples read as zero; without one they
+  //are flushed here (zero comes out as zero in every mode either way)
+  T flushed[kMaxChannels];
+  for (int c=0; c<nChannels; c++) {
+#if DENORMALS_FLUSHED_IN_HARDWARE
+    flushed[c] = dry[c];
+#else
+    flushed[c] = DenormalOrZero(&dry[c]) ? 0 : dry[c];
+#endif
+    wet[c] = flushed[c];
+  }
+  const bool oversampled = mOversamplingOn && mRateFactor[j] == 1;
+  if (!mEnable[j]) {
+    //as late as the shaped bands
+    if (oversampled) mOversampler[j].DelayDry(wet, nChannels);
+    //nothing shaped to meter
+    UpdateMeter(j, 0);
+    return;
+  }
+
+  const T drive = DBToAmp((T)mDriveSmoother[j].process(mDrive[j]));
+  for (int c=0; c<nChannels; c++) wet[c] *= drive;
+
+  //Gain comp
+  const T makeup = DBToAmp((T)mOutputSmoother[j].process(-.7 * mDrive[j]));
+  const T mix = (T)mMix[j];
+
+  //Distortion and mix. Oversampled, the dry signal is delayed to match and
+  //mix and makeup go on the high rate frames, ahead of the decimation, the same
+  //whether the band is decimated on its own or in the shared sum
+  const int order = mChebyshevOrder[j], fromOrder = mOrderFrom[j];
+  T peak = 0;
+  if (mSharedBands & (1u << j)) {
+    mShapedGain[j] = mix * makeup;
+    const T* high = mOversampler[j].Upsample(wet, flushed, nChannels, [this, j, order, fromOrder](T* x, int n) { ShapeBand(j, x, n, order, fromOrder); });
+    mOversampler[j].Scale(mShapedGain[j], nChannels);
+    //the wet part into the shared sum, the dry part stays here; the meter reads the high rate peak
+    for (int p=0; p<mSharedFactor; p++) {
+      T* sum = &mHighSum[p * kMaxChannels];
+      const T* x = &high[p * kMaxChannels];
+      for (int c=0; c<nChannels; c++) {
+        sum[c] += x[c];
+        const T sample = x[c] + (1-mix) * flushed[c];
+        if (std::fabs(sample) > peak) peak = std::fabs(sample);
+      }
+    }
+    for (int c=0; c<nChannels; c++) wet[c] = (1-mix) * flushed[c];
+  }
+  else if (oversampled) {
+    mShapedGain[j] = mix * makeup;
+    mOversampler[j].Process(wet, flushed, nChannels, [this, j, order, fromOrder](T* x, int n) { ShapeBand(j, x, n, order, fromOrder); }, mShapedGain[j]);
+    for (int c=0; c<nChannels; c++) {
+      wet[c] += (1-mix)*flushed[c];
+      if (std::fabs(wet[c]) > peak) peak = std::fabs(wet[c]);
+    }
+  }
+  else {
+    ShapeBand(j, wet, nChannels, order, fromOrder);
+    for (int c=0; c<nChannels; c++) {
+      wet[c] *= makeup;
+      wet[c] = mix*wet[c]+(1-mix)*flushed[c];
+      if (std::fabs(wet[c]) > peak) peak = std::fabs(wet[c]);
+    }
+  }
+
+  UpdateMeter(j, peak);
+}
+
+//Update level meters, decaying per host frame also for a decimated band
+template <typename T>
+inline void MultibandEngineT<T>::UpdateMeter(int j, T peak)
+{
+  float level = mPeakFollower[j]->process(peak);
+  for (int i=1; i<mRateFactor[j]; i++) level = mPeakFollower[j]->process(peak);
+  mMeterLevel[j] = log10(level)+1;
+}
+
+//A frame into a delay ring of delay+1 or more frames, the frame from delay frames ago out
+template <typename T>
+inline void MultibandEngineT<T>::DelayFrame(std::vector<T>& ring, int& pos, int delay, T* frame, int nChannels)
+{
+  const int frames = (int)(ring.size() / kMaxChannels);
+  T* in = &ring[pos * kMaxChannels];
+  for (int c=0; c<nChannels; c++) in[c] = frame[c];
+  const T* out = &ring[(pos >= delay ? pos - delay : pos - delay + frames) * kMaxChannels];
+  for (int c=0; c<nChannels; c++) frame[c] = out[c];
+  if (++pos == frames) pos = 0;
+}
+
+//One band of a frame as ProcessBand, at the band's rate. A decimated band
+//comes out with the latency of the host rate bands' delay after SumBands.
+template <typename T>
+inline void MultibandEngineT<T>::RunBand(int j, const T* dry, T* wet, int nChannels)
+{
+  const int factor = mRateFactor[j];
+  if (factor == 1) {
+    ProcessBand(j, dry, wet, nChannels);
+    return;
+  }
+
+  //every factor-th frame is processed, the crossover filter before has done the anti-aliasing
+  const int length = mLowLength;
+  if (mRatePhase[j] == 0) {
+    if (++mLowPos[j] == length) mLowPos[j] = 0;
+    T* newest = &mLowHistory[j][(mLowPos[j] + length) * kMaxChannels];
+    ProcessBand(j, dry, newest, nChannels);
+    T* copy = &mLowHistory[j][mLowPos[j] * kMaxChannels];
+    for (int c=0; c<nChannels; c++) copy[c] = newest[c];
+  }
+  InterpolateBand(j, wet, nChannels);
+}
+
+//A decimated band's output frame from its history, zero stuffed and interpolated:
+//only every factor-th tap meets a sample
+template <typename T>
+inline void MultibandEngineT<T>::InterpolateBand(int j, T* wet, int nChannels)
+{
+  const T* h = mBandInterpolator[j] + mRatePhase[j] * kPhaseTaps;
+  const T* x = &mLowHistory[j][(mLowPos[j] + mLowLength - mLowDelay[j]) * kMaxChannels];
+  for (int c=0; c<nChannels; c++) {
+    //two sums, so the adds overlap
+    T even = h[0] * x[c], odd = 0;
+    for (int m=1; m<kPhaseTaps-1; m+=2) {
+      odd += h[m] * x[c - m * kMaxChannels];
+      even += h[m + 1] * x[c - (m + 1) * kMaxChannels];
+    }
+    wet[c] = even + odd;
+  }
+  if (++mRatePhase[j] == mRateFactor[j]) mRatePhase[j] = 0;
+}
+
+//Nothing left in the multirate histories and delays
+template <typename T>
+bool MultibandEngineT<T>::MultirateQuiet() const
+{
+  for (int j=0; j<4; j++) {
+    if (!mLowHistory[j].empty() && BlockPeak(&mLowHistory[j][0], (int)mLowHistory[j].size()) > kSilenceThreshold) return false;
+  }
+  if (!mHostDelay.empty() && BlockPeak(&mHostDelay[0], (int)mHostDelay.size()) > kSilenceThreshold) return false;
+  if (!mHandOff.empty() && BlockPeak(&mHandOff[0], (int)mHandOff.size()) > kSilenceThreshold) return false;
+  return mLinkedDelay.empty() || BlockPeak(&mLinkedDelay[0], (int)mLinkedDelay.size()) <= kSilenceThreshold;
+}
+
+//Sum of the bands' wet frames, or the first soloed band alone; in multirate
+//mode every band comes out mLatency frames late
+template <typename T>
+inline void MultibandEngineT<T>::SumBands(const T* const wet[4], T* frame, int nChannels)
+{
+  int solo = -1;
+  for (int j=0; j<4; j++) {
+    if (mSolo[j]) {
+      solo = j;
+      break;
+    }
+  }
+  if (mMultirate) {
+    //the host rate bands' sum through the delay, then the decimated bands, already aligned
+    for (int c=0; c<nChannels; c++) {
+      T sample=0;
+      for (int j=0; j<4; j++) {
+        if (mRateFactor[j] == 1 && (solo < 0 || j == solo)) sample+=wet[j][c];
+      }
+      frame[c] = sample;
+    }
+    DelayFrame(mHostDelay, mHostDelayPos, mLatency, frame, nChannels);
+    for (int j=0; j<4; j++) {
+      if (mRateFactor[j] == 1 || (solo >= 0 && j != solo)) continue;
+      for (int c=0; c<nChannels; c++) frame[c] += wet[j][c];
+    }
+    //what bands handed off by a crossover move had still to play, every channel
+    //cleared behind it
+    T* handOff = &mHandOff[mHandOffPos * kMaxChannels];
+    for (int c=0; c<nChannels; c++) frame[c] += handOff[c];
+    std::fill_n(handOff, kMaxChannels, (T)0);
+    if (++mHandOffPos * kMaxChannels == (int)mHandOff.size()) mHandOffPos = 0;
+  }
+  else if (solo >= 0) {
+    for (int c=0; c<nChannels; c++) frame[c] = wet[solo][c];
+  }
+  else {
+    for (int c=0; c<nChannels; c++) {
+      T sample=0;
+      for (int j=0; j<4; j++) sample+=wet[j][c];
+      frame[c] = sample;
+    }
+  }
+}
+
+//Bands: samplesFilteredWet[][] from samplesFilteredDry[][], their sum into frame
+template <typename T>
+inline void MultibandEngineT<T>::ProcessBandFrame(T* frame, int nChannels)
+{
+  if (mSharedBands) std::fill(mHighSum, mHighSum + mSharedFactor * kMaxChannels, (T)0);
+
+  //Loop through bands, process samples
+  for (int j=0; j<4; j++) RunBand(j, samplesFilteredDry[j], samplesFilteredWet[j], nChannels);
+
+  //the shared decimator's output joins the first shared band's wet, which is
+  //summed like any host rate band's
+  if (mSharedBands) {
+    T decimated[kMaxChannels];
+    mSumDecimator.Decimate(mHighSum, decimated, nChannels);
+    int first = 0;
+    while (!(mSharedBands & (1u << first))) first++;
+    for (int c=0; c<nChannels; c++) samplesFilteredWet[first][c] += decimated[c];
+  }
+
+  const T* wet[4] = { samplesFilteredWet[0], samplesFilteredWet[1], samplesFilteredWet[2], samplesFilteredWet[3] };
+  SumBands(wet, frame, nChannels);
+}
+
+//Linked controls: band 1's settings on the full band signal
+template <typename T>
+inline void MultibandEngineT<T>::ProcessLinkedFrame(T* frame, int nChannels)
+{
+  T drySample[kMaxChannels];
+  for (int c=0; c<nChannels; c++) drySample[c] = frame[c];
+
+  //Pre gain
+  const T drive = DBToAmp((T)(mLinkedDriveSmoother.process(mDrive[0])/1.5));
+  for (int c=0; c<nChannels; c++) frame[c] *= drive;
+
+  //Distortion
+  const int order = mLinkedChebyshevOrder, fromOrder = mLinkedOrderFrom;
+  if (mOversamplingOn) mLinkedOversampler.Process(frame, drySample, nChannels, [this, order, fromOrder](T* x, int n) { ShapeBand(0, x, n, order, fromOrder); });
+  else ShapeBand(0, frame, nChannels, order, fromOrder);
+
+  //Gain comp
+  const T makeup = DBToAmp((T)(mLinkedOutputSmoother.process(-.7 * mDrive[0])/1.5));
+
+  //sample *= rmsDry[0].getRMS(drySample, i) / rmsWet[0].getRMS(sample, i);
+
+  //Mix
+  const T mix = (T)mMix[0];
+  T peak = 0;
+  for (int c=0; c<nChannels; c++) {
+    frame[c] *= makeup;
+    frame[c] = mix * frame[c] + (1-mix) * drySample[c];
+    if (std::fabs(frame[c]) > peak) peak = std::fabs(frame[c]);
+  }
+
+  //Update level meters
+  mMeterLevel[0] = log10(mPeakFollower[0]->process(peak))+1;
+  mMeterLevel[1] = mMeterLevel[2] = mMeterLevel[3] = 0;
+}
+
+template <typename T>
+inline void MultibandEngineT<T>::ClipOutput(T* frame, int nChannels)
+{
+  //Clipping
+  if(mOutputClipping){
+    const T ceiling = DBToAmp((T)-0.1);
+    for (int c=0; c<nChannels; c++) {
+      if (frame[c]>1) {
+        frame[c] = ceiling;
+      }
+      else if (frame[c]<-1) {
+        frame[c] = -1*ceiling;
+      }
+    }
+  }
+}
+
+//Silent input, and with the controls unlinked a filterbank that has rung out
+template <typename T>
+bool MultibandEngineT<T>::CanSkipBlock(T** inputs, int nChannels, int nFrames)
+{
+  const double threshold = kSilenceThreshold / DBToAmp(mInputGain);
+  for (int c = 0; c < nChannels; c++) {
+    if (BlockPeak(inputs[c], nFrames) > threshold) return false;
+  }
+  if (mMultirate && !MultirateQuiet()) return false;
+  if (mOversamplingOn) {
+    for (int j=0; j<4; j++) {
+      if (mOversampler[j].Peak() > kSilenceThreshold) return false;
+    }
+    if (mLinkedOversampler.Peak() > kSilenceThreshold) return false;
+    if (mSumDecimator.Peak() > kSilenceThreshold) return false;
+  }
+  if (mControlsLinked) return true;
+
+  //filters left out are reset when they come back in, their state does not count
+  const unsigned int used = SplitFilters(mSplitBands);
+  return (!(used & kBand1lp) || band1lp.isQuiet(kSilenceThreshold)) &&
+         (!(used & kBand2hp) || band2hp.isQuiet(kSilenceThreshold)) &&
+         (!(used & kBand4hp) || band4hp.isQuiet(kSilenceThreshold)) &&
+         (!(used & kBand3lp) || band3lp.isQuiet(kSilenceThreshold)) &&
+         (!(used & kBand3hp) || band3hp.isQuiet(kSilenceThreshold)) &&
+         (!(used & kBand2lp) || band2lp.isQuiet(kSilenceThreshold));
+}
+
+//Silence out; the smoothers and meters run on as they would have on silence in
+template <typename T>
+void MultibandEngineT<T>::SkipBlock(T** outputs, int nChannels, int nFrames)
+{
+  for (int c = 0; c < nChannels; c++) memset(outputs[c], 0, nFrames * sizeof(T));
+
+  //what is left of the tail is dropped, the next sound starts from rest
+  if (!mControlsLinked) {
+    band1lp.reset();
+    band2hp.reset();
+    band2lp.reset();
+    band3hp.reset();
+    band3lp.reset();
+    band4hp.reset();
+  }
+
+  //linked controls run band 1's smoothers and meter only
+  const int bands = mControlsLinked ? 1 : 4;
+  for (int j=0; j<bands; j++) {
+    //a band left out or bypassed runs no smoothers, but its meter falls as in ProcessBand
+    const bool shaped = mControlsLinked || ((mActiveBands & (1u << j)) && mEnable[j]);
+    double drive = 0, makeup = 0;
+    float peak = 0;
+    CParamSmooth& driveSmoother = mControlsLinked ? mLinkedDriveSmoother : mDriveSmoother[j];
+    CParamSmooth& outputSmoother = mControlsLinked ? mLinkedOutputSmoother : mOutputSmoother[j];
+    for (int s = 0; s < nFrames; ++s) {
+      const double lastDrive = drive, lastMakeup = makeup;
+      if (shaped) {
+        drive = driveSmoother.process(mDrive[j]);
+        makeup = outputSmoother.process(-.7 * mDrive[j]);
+      }
+      peak = mPeakFollower[j]->process(0);
+      //settled smoothers and a meter at zero stay where they are
+      if (s > 0 && drive == lastDrive && makeup == lastMakeup && peak == 0) break;
+    }
+    if (nFrames > 0) mMeterLevel[j] = log10(peak)+1;
+  }
+  if (mControlsLinked) mMeterLevel[1] = mMeterLevel[2] = mMeterLevel[3] = 0;
+
+  //nothing to fade between
+  mLinkFade = 0;
+  for (int j=0; j<4; j++) mModeFade[j] = 0;
+
+  //the delays held nothing above the threshold either
+  if (mMultirate) {
+    for (int j=0; j<4; j++) ClearMultirate(j);
+    std::fill(mHostDelay.begin(), mHostDelay.end(), (T)0);
+    std::fill(mHandOff.begin(), mHandOff.end(), (T)0);
+    std::fill(mLinkedDelay.begin(), mLinkedDelay.end(), (T)0);
+    mHostDelayPos = mHandOffPos = mLinkedDelayPos = 0;
+  }
+  for (int j=0; j<4; j++) mOversampler[j].Reset();
+  mLinkedOversampler.Reset();
+  mSumDecimator.Reset();
+
+  double gain = 0;
+  for (int s = 0; s < nFrames; ++s) {
+    const double lastGain = gain;
+    gain = mInputGainSmoother.process(mInputGain);
+    if (s > 0 && gain == lastGain) break;
+  }
+
+  if (mTapRing && mTaps) {
+    for (int s = 0; s < nFrames; ++s) {
+      float* tap = mTapRing->WriteFrame();
+      if (!tap) break;
+      for (int i = 0; i < kNumTaps; i++) tap[i] = 0;
+    }
+    mTapRing->Publish();
+  }
+}
+
+template <typename T>
+void MultibandEngineT<T>::ProcessBlock(T** inputs, T** outputs, int nChannels, int nFrames)
+{
+  RealtimeScope realtime;
+  FlushDenormalsScope flushDenormals;
+
+  if (nChannels > kMaxChannels) nChannels = kMaxChannels;
+
+  UpdateFades();
+
+  //linked controls do not use the filterbank, but for fading out of or into it
+  mActiveBands = ActiveBands();
+  SetSplitBands(mControlsLinked && !mLinkFade ? 0 : mActiveBands);
+
+  //the bands on the pool decimate each on its own
+  const bool parallel = mWorkerPool && !mControlsLinked && !mLinkFade && nFrames >= mParallelMinFrames;
+  UpdateOversampling(nChannels, !parallel);
+
+  if (mSilenceSkip && CanSkipBlock(inputs, nChannels, nFrames)) {
+    SkipBlock(outputs, nChannels, nFrames);
+    return;
+  }
+
+  if (parallel) {
+    for (int pos = 0; pos < nFrames; pos += kParallelChunk) {
+      T* in[kMaxChannels];
+      T* out[kMaxChannels];
+      for (int c = 0; c < nChannels; c++) {
+        in[c] = inputs[c] + pos;
+        out[c] = outputs[c] + pos;
+      }
+      ProcessChunkParallel(in, out, nChannels, nFrames - pos < kParallelChunk ? nFrames - pos : kParallelChunk);
+    }
+    if (mTapRing && mTaps) mTapRing->Publish();
+    return;
+  }
+
+  //Analyzer taps nobody is looking at are not written
+  const unsigned int taps = mTapRing ? mTaps : 0;
+  const float tapScale = 1.f / nChannels;
+
+  for (int s = 0; s < nFrames; ++s) {
+    T frame[kMaxChannels];
+    for (int c = 0; c < nChannels; c++) frame[c] = inputs[c][s];
+
+    float* tap = taps ? mTapRing->WriteFrame() : 0;
+    if (tap) {
+      float sum = 0;
+      for (int c = 0; c < nChannels; c++) sum += (float)frame[c];
+      tap[kTapInput] = sum * tapScale;
+    }
+
+    //Apply input gain
+    const T gain = DBToAmp((T)mInputGainSmoother.process(mInputGain)); //parameter smoothing prevents popping when changing parameter value
+    for (int c = 0; c < nChannels; c++) frame[c] *= gain;
+
+    if (mControlsLinked && !mLinkFade) {
+      ProcessLinkedFrame(frame, nChannels);
+      if (mMultirate) DelayFrame(mLinkedDelay, mLinkedDelayPos, mLatency, frame, nChannels);
+
+      if (tap) {
+        for (int j=0; j<4; j++) {
+          tap[kTapBand1Dry+j] = tap[kTapBand1Wet+j] = 0;
+        }
+      }
+    }
+
+    else{
+      //between linked and multiband controls: both, at equal power
+      T linked[kMaxChannels];
+      if (mLinkFade) {
+        for (int c = 0; c < nChannels; c++) linked[c] = frame[c];
+        ProcessLinkedFrame(linked, nChannels);
+        if (mMultirate) DelayFrame(mLinkedDelay, mLinkedDelayPos, mLatency, linked, nChannels);
+      }
+
+      SplitFrame(frame, nChannels);
+      ProcessBandFrame(frame, nChannels);
+
+      if (mLinkFade) {
+        const int k = mFadeLength - mLinkFade--;
+        const T fadeIn = (T)mFadeCurve[k + 1], fadeOut = (T)mFadeCurve[mFadeLength - k - 1];
+        const T toLinked = mControlsLinked ? fadeIn : fadeOut, toBands = mControlsLinked ? fadeOut : fadeIn;
+        for (int c = 0; c < nChannels; c++) frame[c] = toLinked * linked[c] + toBands * frame[c];
+      }
+
+      if (tap) {
+        for (int j=0; j<4; j++) {
+          float dry = 0, wet = 0;
+          for (int c = 0; c < nChannels; c++) {
+            dry += (float)samplesFilteredDry[j][c];
+            wet += (float)samplesFilteredWet[j][c];
+          }
+          tap[kTapBand1Dry+j] = dry * tapScale;
+          tap[kTapBand1Wet+j] = wet * tapScale;
+        }
+      }
+    }//End multiband processing block
+    AdvanceModeFades();
+
+    ClipOutput(frame, nChannels);
+
+    if (tap) {
+      float sum = 0;
+      for (int c = 0; c < nChannels; c++) sum += (float)frame[c];
+      tap[kTapOutput] = sum * tapScale;
+    }
+
+    for (int c = 0; c < nChannels; c++) outputs[c][s] = frame[c];
+  }
+
+  if (taps) mTapRing->Publish();
+}
+
+template <typename T>
+void MultibandEngineT<T>::SetWorkerPool(WorkerPool* pool, int minFrames)
+{
+  mWorkerPool = pool;
+  mParallelMinFrames = minFrames;
+  if (pool) {
+    mBandDry.assign(4 * kParallelChunk * kMaxChannels, 0);
+    mBandWet.assign(4 * kParallelChunk * kMaxChannels, 0);
+  }
+  else {
+    std::vector<T>().swap(mBandDry);
+    std::vector<T>().swap(mBandWet);
+  }
+}
+
+template <typename T>
+void MultibandEngineT<T>::BandTask(void* engine, int band)
+{
+  //the floating point mode is per thread, workers set their own
+  FlushDenormalsScope flushDenormals;
+  MultibandEngineT<T>* self = (MultibandEngineT<T>*)engine;
+  const int nChannels = self->mChunkChannels;
+  const int stride = kParallelChunk * kMaxChannels;
+  const T* dry = &self->mBandDry[band * stride];
+  T* wet = &self->mBandWet[band * stride];
+  for (int s = 0; s < self->mChunkFrames; s++, dry += nChannels, wet += nChannels) {
+    self->RunBand(band, dry, wet, nChannels);
+    //the band's own fade, nothing else touches it while the pool runs
+    if (self->mModeFade[band] > 0) self->mModeFade[band]--;
+  }
+}
+
+//Up to kParallelChunk frames: split here, the bands on the pool, sum here
+template <typename T>
+void MultibandEngineT<T>::ProcessChunkParallel(T** inputs, T** outputs, int nChannels, int nFrames)
+{
+  const int stride = kParallelChunk * kMaxChannels;
+
+  for (int s = 0; s < nFrames; ++s) {
+    T frame[kMaxChannels];
+    const T gain = DBToAmp((T)mInputGainSmoother.process(mInputGain));
+    for (int c = 0; c < nChannels; c++) frame[c] = inputs[c][s] * gain;
+    SplitFrame(frame, nChannels);
+    for (int j=0; j<4; j++) {
+      T* dry = &mBandDry[j * stride + s * nChannels];
+      for (int c = 0; c < nChannels; c++) dry[c] = samplesFilteredDry[j][c];
+    }
+  }
+
+  mChunkChannels = nChannels;
+  mChunkFrames = nFrames;
+  mWorkerPool->Run(BandTask, this, 4);
+
+  const unsigned int taps = mTapRing ? mTaps : 0;
+  const float tapScale = 1.f / nChannels;
+  for (int s = 0; s < nFrames; ++s) {
+    const T* dry[4];
+    const T* wet[4];
+    for (int j=0; j<4; j++) {
+      dry[j] = &mBandDry[j * stride + s * nChannels];
+      wet[j] = &mBandWet[j * stride + s * nChannels];
+    }
+    T frame[kMaxChannels];
+    SumBands(wet, frame, nChannels);
+    ClipOutput(frame, nChannels);
+
+    float* tap = taps ? mTapRing->WriteFrame() : 0;
+    if (tap) {
+      float in = 0, out = 0;
+      for (int c = 0; c < nChannels; c++) {
+        in += (float)inputs[c][s];
+        out += (float)frame[c];
+      }
+      tap[kTapInput] = in * tapScale;
+      tap[kTapOutput] = out * tapScale;
+      for (int j=0; j<4; j++) {
+        float d = 0, w = 0;
+        for (int c = 0; c < nChannels; c++) {
+          d += (float)dry[j][c];
+          w += (float)wet[j][c];
+        }
+        tap[kTapBand1Dry+j] = d * tapScale;
+        tap[kTapBand1Wet+j] = w * tapScale;
+      }
+    }
+
+    for (int c = 0; c < nChannels; c++) outputs[c][s] = frame[c];
+  }
+}
+
+template <typename T>
+void MultibandEngineT<T>::SplitBlock(T** inputs, T** bands[4], int nChannels, int nFrames)
+{
+  RealtimeScope realtime;
+  FlushDenormalsScope flushDenormals;
+
+  if (nChannels > kMaxChannels) nChannels = kMaxChannels;
+
+  //the bands may go to settings with other solos and mutes
+  SetSplitBands(15);
+
+  for (int s = 0; s < nFrames; ++s) {
+    T frame[kMaxChannels];
+    const T gain = DBToAmp((T)mInputGainSmoother.process(mInputGain));
+    for (int c = 0; c < nChannels; c++) frame[c] = inputs[c][s] * gain;
+    SplitFrame(frame, nChannels);
+    for (int j=0; j<4; j++) {
+      for (int c = 0; c < nChannels; c++) bands[j][c][s] = samplesFilteredDry[j][c];
+    }
+  }
+}
+
+template <typename T>
+void MultibandEngineT<T>::ProcessBands(T** bands[4], T** outputs, int nChannels, int nFrames)
+{
+  RealtimeScope realtime;
+  FlushDenormalsScope flushDenormals;
+
+  if (nChannels > kMaxChannels) nChannels = kMaxChannels;
+
+  UpdateFades();
+  mActiveBands = ActiveBands();
+  UpdateOversampling(nChannels, true);
+
+  for (int s = 0; s < nFrames; ++s) {
+    T frame[kMaxChannels];
+    for (int j=0; j<4; j++) {
+      for (int c = 0; c < nChannels; c++) samplesFilteredDry[j][c] = bands[j][c][s];
+    }
+    ProcessBandFrame(frame, nChannels);
+    AdvanceModeFades();
+    ClipOutput(frame, nChannels);
+    for (int c = 0; c < nChannels; c++) outputs[c][s] = frame[c];
+  }
+}
+
+template class MultibandEngineT<double>;
+template class MultibandEngineT<float>;
@@ -0,0 +1,306 @@
+//
+//  MultibandEngine.h
+//  MultibandDistortion
+//
+//  The plugin's signal path without IPlug: input gain, the Linkwitz-Riley
+//  filterbank, per-band drive/distortion/mix, solo/mute, summing and output
+//  clipping. The plugin forwards its parameters here; the command line tools
+//  and benchmarks drive it directly.
+//
+//  The engine is a template on the sample type. MultibandEngine (double) is the
+//  plugin's path; MultibandEngineFloat runs gain, waveshaping, mixing and
+//  summing in float for float hosts and batch rendering. The Linkwitz-Riley
+//  filterbank is double in both, a 4th order direct form at low crossovers does
+//  not hold up in single precision.
+//
+//  Up to kMaxChannels channels are processed a frame at a time with the band
+//  controls and smoothers shared, so the channels' filter and shaper state
+//  advances side by side instead of one channel's block after the other.
+//
+//  Only the bands that reach the output are processed: a muted band, or every
+//  band but the soloed one, is not, and neither are the crossover filters that
+//  feed nothing else. Filters that come back in start from rest.
+//
+//  In multirate mode the low bands run decimated: a band whose rate can drop
+//  by a power of two, 4 or more, and still keep 16 harmonics of its top
+//  crossover below Nyquist takes every n-th sample of its crossover filter's
+//  output, which doubles as the anti-aliasing filter, and is interpolated back
+//  to the host rate with a polyphase windowed sinc. Every other path is delayed
+//  to match, so the engine reports a fixed latency while the mode is on.
+//
+//  Each band's shaper can be oversampled by 2, 4 or 8 (Oversampler.h), or by a
+//  factor picked from the band's top edge and drive: enough for the harmonics
+//  the drive brings up to stay below the raised Nyquist. Linked controls take
+//  band 1's setting for the full band. Once any band's setting is other than
+//  1x, every band and the linked path run through an oversampler, 1x ones as a
+//  plain delay, so they all come out kLatency frames late and sum as before.
+//  Decimated multirate bands already have the headroom and are only delayed.
+//  When the bands being shaped all run at the same factor, their high rate
+//  frames are summed and decimated once instead of band by band; not on the
+//  worker pool, and not while the analyzer taps the bands' wet signals.
+//
+//  Switching between linked and multiband controls, and a band's distortion
+//  mode, is crossfaded over kFadeMs with equal power gains. Both sides run
+//  during the fade only; the side coming in starts from rest under its fade-in.
+//  A change back mid fade reverses it from where it is; any other change waits
+//  for the fade running to finish.
+//  Settings made before the first block after construction or SetSampleRate
+//  apply at once.
+//
+//  ProcessBlock skips blocks of silent input once the filterbank has rung out:
+//  the output is silence then, and only the smoothers and meters are run on.
+//
+//  Every processing call runs with denormals flushed to zero (DenormalGuard.h),
+//  which also covers the filterbank's feedback state as it decays after the
+//  input stops.
+//
+
+#ifndef MultibandEngine_h
+#define MultibandEngine_h
+
+#include "CParamSmooth.h"
+#include "PeakFollower.h"
+#include "RMS.h"
+#include "LinkwitzRiley.h"
+#include "TapRing.h"
+#include "WorkerPool.h"
+#include "Oversampler.h"
+#include "WaveshaperTables.h"
+#include <vector>
+
+//Channels one engine processes
+static const int kMaxChannels = LinkwitzRiley::maxChannels;
+
+//Analyzer taps, one stream each in the analysis ring, the mean of all channels
+enum ETaps
+{
+  kTapOutput=0,
+  kTapInput,
+  kTapBand1Dry,
+  kTapBand2Dry,
+  kTapBand3Dry,
+  kTapBand4Dry,
+  kTapBand1Wet,
+  kTapBand2Wet,
+  kTapBand3Wet,
+  kTapBand4Wet,
+  kNumTaps
+};
+
+template <typename T>
+class MultibandEngineT
+{
+public:
+  typedef T Sample;
+
+  MultibandEngineT(double sampleRate);
+  ~MultibandEngineT();
+
+  //Rebuilds filters, smoothers and followers for a new rate
+  void SetSampleRate(double sampleRate);
+
+  //Parameters, in the units of the plugin's parameters (dB, 0..1 mix, Hz)
+  void SetInputGain(double dB) { mInputGain = dB; }
+  void SetDrive(int band, double dB) { mDrive[band] = dB; }
+  void SetMix(int band, double mix) { mMix[band] = mix; }
+  void SetMode(int band, int mode) { mDistMode[band] = mode; }
+  void SetEnable(int band, bool enable) { mEnable[band] = enable; }
+  void SetMute(int band, bool mute) { mMute[band] = mute; }
+  void SetSolo(int band, bool solo) { mSolo[band] = solo; }
+  void SetLinked(bool linked) { mControlsLinked = linked; }
+  void SetOutputClipping(bool clip) { mOutputClipping = clip; }
+  //The table driven waveshapers of WaveshaperTables.h instead of the exact curves
+  void SetFastShapers(bool fast) { mFastShapers = fast; }
+  void SetCrossover(int crossover, double freq);
+  void SetSilenceSkip(bool skip) { mSilenceSkip = skip; }
+  //Allocates, so not while processing
+  void SetMultirate(bool multirate);
+
+  //0 picks the factor from the band's top edge and drive, else 1, 2, 4 or 8
+  void SetOversampling(int band, int factor);
+  //The factor a band's shaper runs at, as of the last block
+  int GetOversamplingFactor(int band) const { return mOversampler[band].GetFactor(); }
+
+  //Frames the output lags the input by, nonzero in multirate mode or with oversampling
+  int GetLatencySamples() const { return mLatency + (mOversamplingOn ? Oversampler::kLatency : 0); }
+  //Host rate frames per processed sample of a band, 1 unless multirate
+  int GetRateFactor(int band) const { return mRateFactor[band]; }
+
+  double GetCrossover(int crossover) const { return mCrossoverFreq[crossover]; }
+
+  //Samples the output can go on after the input has stopped, at full scale and
+  //the highest input gain: the filterbank's ring out at the lowest crossover
+  int GetTailSamples() const;
+
+  //Taps in the mask are written to the ring, one frame per processed sample
+  void SetTaps(Spect_TapRing* ring, unsigned int taps) { mTapRing = ring; mTaps = taps; }
+
+  //Bands on a worker pool, for unlinked blocks of at least minFrames frames;
+  //shorter blocks are processed serially, where the hand over would cost more
+  //than it saves. 0 turns it off. Allocates, so not while processing.
+  void SetWorkerPool(WorkerPool* pool, int minFrames = 128);
+
+  //Processes up to kMaxChannels channels
+  void ProcessBlock(T** inputs, T** outputs, int nChannels, int nFrames);
+
+  //ProcessBlock in two passes, so one band split can feed several band settings.
+  //bands[j][c] is band j of channel c. Both passes assume unlinked controls and
+  //write no analyzer taps or skip silence; everything else is as in ProcessBlock.
+  void SplitBlock(T** inputs, T** bands[4], int nChannels, int nFrames);
+  void ProcessBands(T** bands[4], T** outputs, int nChannels, int nFrames);
+
+  //Peak level of a band's last processed sample, log10(peak)+1
+  double GetMeterLevel(int band) const { return mMeterLevel[band]; }
+
+  T ProcessDistortion(T sample, int distType);
+
+private:
+  void SplitFrame(const T* frame, int nChannels);
+  void ProcessBandFrame(T* frame, int nChannels);
+  void ProcessLinkedFrame(T* frame, int nChannels);
+  void ClipOutput(T* frame, int nChannels);
+  void ProcessBand(int band, const T* dry, T* wet, int nChannels);
+  void UpdateMeter(int band, T peak);
+  void SumBands(const T* const wet[4], T* frame, int nChannels);
+  void UpdateRateFactors(bool handOff = false);
+  void HandOffMultirate(int band);
+  void RunBand(int band, const T* dry, T* wet, int nChannels);
+  void InterpolateBand(int band, T* wet, int nChannels);
+  void DelayFrame(std::vector<T>& ring, int& pos, int delay, T* frame, int nChannels);
+  bool MultirateQuiet() const;
+  void ClearMultirate(int band);
+  void UpdateFades();
+  void AdvanceModeFades();
+  void StartModeFade(int band);
+  void ShapeBand(int band, T* x, int nChannels, int order, int fromOrder);
+  int ChebyshevOrder(double edge, double rate) const;
+  void SetChebyshevOrder(int band, int order);
+  void UpdateOversampling(int nChannels, bool shareable);
+  int AutoOversampling(double edge, double dB) const;
+  unsigned int ActiveBands() const;
+  void SetSplitBands(unsigned int bands);
+  bool CanSkipBlock(T** inputs, int nChannels, int nFrames);
+  void SkipBlock(T** outputs, int nChannels, int nFrames);
+  void ProcessChunkParallel(T** inputs, T** outputs, int nChannels, int nFrames);
+  static void BandTask(void* engine, int band);
+
+  //Frames per hand over to the pool
+  enum { kParallelChunk = 256 };
+
+  typedef OversamplerT<T, kMaxChannels> Oversampler;
+
+  //Multirate: the largest decimation, and the interpolator's taps per phase
+  enum { kMaxRateFactor = 16, kInterpolatorTaps = 12, kPhaseTaps = kInterpolatorTaps + 1 };
+
+  CParamSmooth mInputGainSmoother;
+  CParamSmooth mDriveSmoother[4];
+  CParamSmooth mOutputSmoother[4];
+  CParamSmooth mLinkedDriveSmoother;
+  CParamSmooth mLinkedOutputSmoother;
+
+  PeakFollower* mPeakFollower[4];
+
+  LinkwitzRiley band1lp;
+  LinkwitzRiley band2hp;
+  LinkwitzRiley band2lp;
+  LinkwitzRiley band3hp;
+  LinkwitzRiley band3lp;
+  LinkwitzRiley band4hp;
+
+  RMSFollower rmsDry[4];
+  RMSFollower rmsWet[4];
+
+  Spect_TapRing* mTapRing;
+  unsigned int mTaps;
+
+  WorkerPool* mWorkerPool;
+  int mParallelMinFrames;
+  std::vector<T> mBandDry, mBandWet; //[band][frame][channel], kParallelChunk frames
+  int mChunkChannels, mChunkFrames;
+
+  //Multirate: a decimated band keeps its last mLowLength wet samples twice
+  //over, at k and k + mLowLength, and runs mRatePhase[j] host frames past the
+  //newest. It is latency aligned by interpolating mLowDelay[j] samples back in
+  //that history; the host rate bands are delayed after their sum and the linked
+  //path on its own. mInterpolator[i] is for a factor of 2^i.
+  bool mMultirate;
+  int mLatency;
+  int mRateFactor[4];
+  int mRatePhase[4];
+  int mLowDelay[4];
+  int mLowLength;
+  int mLowPos[4];
+  std::vector<T> mLowHistory[4];
+  std::vector<T> mInterpolator[5];
+  const T* mBandInterpolator[4];
+  std::vector<T> mHostDelay;
+  int mHostDelayPos;
+  std::vector<T> mLinkedDelay;
+  int mLinkedDelayPos;
+  //A band whose factor a crossover move changes hands off: what its old path
+  //had still to play is added into this ring, which SumBands reads out with the
+  //decimated bands, and the new path starts from the move
+  std::vector<T> mHandOff;
+  int mHandOffPos;
+
+  //Oversampling: the settings, 0 for auto, and a shaper for each band and the linked path
+  int mOversampling[4];
+  bool mOversamplingOn;
+  Oversampler mOversampler[4];
+  Oversampler mLinkedOversampler;
+  //Shared decimation: bit j of mSharedBands adds band j's shaped frames to
+  //mHighSum at mSharedFactor, for mSumDecimator
+  unsigned int mSharedBands;
+  int mSharedFactor;
+  Oversampler mSumDecimator;
+  T mHighSum[Oversampler::kMaxFactor * kMaxChannels];
+  //mix times makeup, which an oversampled band's shaped frames carry alike
+  //whether it is decimated on its own or in the shared sum
+  T mShapedGain[4];
+
+  //Chebyshev mode: each band's order, and the linked path's, 0 before the
+  //first block; and the orders their crossfades are from
+  int mChebyshevOrder[4];
+  int mLinkedChebyshevOrder;
+  int mOrderFrom[4];
+  int mLinkedOrderFrom;
+
+  //Crossfades: sin(pi/2 x) over mFadeLength frames, frames left of each fade,
+  //the settings being faded to and the modes being faded from; a change of
+  //Chebyshev order fades as a change of mode does
+  std::vector<double> mFadeCurve;
+  int mFadeLength;
+  bool mFadesPrimed;
+  bool mLinkedRun;
+  int mLinkFade;
+  int mModeRun[4];
+  int mModeFrom[4];
+  int mModeFade[4];
+
+  unsigned int mActiveBands; //bit j: band j reaches the output
+  unsigned int mSplitBands;  //bit j: band j is split off the input
+
+  T samplesFilteredDry[4][kMaxChannels];
+  T samplesFilteredWet[4][kMaxChannels];
+  double mMeterLevel[4];
+
+  double mSampleRate;
+  double mInputGain;
+  double mCrossoverFreq[3];
+  double mDrive[4];
+  double mMix[4];
+  int mDistMode[4];
+  bool mMute[4];
+  bool mSolo[4];
+  bool mEnable[4];
+
+  bool mControlsLinked;
+  bool mOutputClipping;
+  bool mSilenceSkip;
+  bool mFastShapers;
+};
+
+typedef MultibandEngineT<double> MultibandEngine;
+typedef MultibandEngineT<float> MultibandEngineFloat;
+
+#endif /* MultibandEngine_h */
@@ -0,0 +1,311 @@
+//
+//  Oversampler.h
+//  MultibandDistortion
+//
+//  Runs a waveshaper at 1, 2, 4 or 8 times the host rate: each frame is
+//  interpolated up with a polyphase windowed sinc, shaped a high rate frame at
+//  a time and decimated with the same lowpass. Both filters are linear phase
+//  and kTaps host frames long, so the output lags kLatency frames at every
+//  factor; a factor of 1 is the same delay without the filtering. The dry signal
+//  is delayed alongside for the mix.
+//
+//  The filters are flat to about 0.4 of the host rate, what the shaper puts
+//  above the host rate's Nyquist is about 50 dB down after decimation.
+//
+//  A gain given to Process, or to Scale after Upsample, goes on the shaped high
+//  rate frames ahead of the decimation, so the history the decimator reads
+//  carries each frame's own gain. Bands shaped at the same factor can then
+//  share one decimator: each band only upsamples, shapes and scales, the caller
+//  sums the high rate frames and decimates the sum through one more
+//  OversamplerT (Decimate), with the same result as decimating every band on
+//  its own. Rebuild starts the shared one from the bands' shaped histories.
+//
+//  The factor can change at any frame. The shaped history is then rebuilt at
+//  the new factor from the input history, as if the new factor had been running
+//  all along, so the output goes on without a step. All buffers are sized for
+//  kMaxFactor when constructed; nothing allocates afterwards.
+//
+
+#ifndef Oversampler_h
+#define Oversampler_h
+
+#define _USE_MATH_DEFINES		// to use M_PI
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+//Modified Bessel function of the first kind, order 0, for Kaiser windows
+inline double BesselI0(double x)
+{
+  double sum = 1., term = 1.;
+  for (int k=1; k<32; k++) {
+    term *= (x / (2. * k)) * (x / (2. * k));
+    sum += term;
+  }
+  return sum;
+}
+
+//Kaiser windowed sinc lowpass, taps*factor+1 long with its center at taps*factor/2,
+//cutoff in cycles per sample of the high rate; zero padded to (taps+1)*factor
+inline void DesignSinc(int taps, int factor, double cutoff, double beta, std::vector<double>& sinc)
+{
+  const int length = taps * factor + 1, center = taps * factor / 2;
+  sinc.assign((taps + 1) * factor, 0.);
+  for (int k=0; k<length; k++) {
+    const double x = k - center, r = x / center;
+    const double s = x == 0 ? 2. * cutoff : sin(2. * M_PI * cutoff * x) / (M_PI * x);
+    sinc[k] = s * BesselI0(beta * sqrt(1. - r * r)) / BesselI0(beta);
+  }
+}
+
+//The same split into its phases for interpolation: phase p's taps are
+//h[p*(taps+1) + m] = sinc[p + m*factor], m = 0..taps, each phase summing to one
+//so DC comes through at unity on every high rate frame
+inline void DesignPolyphaseSinc(int taps, int factor, double cutoff, double beta, std::vector<double>& h)
+{
+  std::vector<double> sinc;
+  DesignSinc(taps, factor, cutoff, beta, sinc);
+  h.assign((taps + 1) * factor, 0.);
+  for (int p=0; p<factor; p++) {
+    double sum = 0.;
+    for (int m=0; m<=taps; m++) sum += sinc[p + m * factor];
+    for (int m=0; m<=taps; m++) h[p * (taps + 1) + m] = sinc[p + m * factor] / sum;
+  }
+}
+
+template <typename T, int Channels>
+class OversamplerT
+{
+public:
+  enum { kTaps = 16, kMaxFactor = 8, kLatency = kTaps };
+
+  OversamplerT() : mFactor(1), mInputPos(0), mShapedPos(0), mDryPos(0), mResting(true)
+  {
+    mInput.assign(2 * kInputLength * Channels, (T)0);
+    mShaped.assign(2 * kShapedLength * Channels, (T)0);
+    mDry.assign((kLatency + 1) * Channels, (T)0);
+    //cutoff at the host rate's Nyquist, beta 5 for about 50 dB
+    std::vector<double> h;
+    for (int i=1; (1 << i) <= kMaxFactor; i++) {
+      const int factor = 1 << i;
+      DesignPolyphaseSinc(kTaps, factor, 0.5 / factor, 5., h);
+      mUp[i].assign(h.begin(), h.end());
+      //the decimator is the whole lowpass, summing to one
+      DesignSinc(kTaps, factor, 0.5 / factor, 5., h);
+      h.resize(kTaps * factor + 1);
+      double sum = 0.;
+      for (size_t k=0; k<h.size(); k++) sum += h[k];
+      mDown[i].resize(h.size());
+      for (size_t k=0; k<h.size(); k++) mDown[i][k] = (T)(h[k] / sum);
+    }
+  }
+
+  int GetFactor() const { return mFactor; }
+
+  //Everything back to silence
+  void Reset()
+  {
+    if (mResting) return;
+    std::fill(mInput.begin(), mInput.end(), (T)0);
+    std::fill(mShaped.begin(), mShaped.end(), (T)0);
+    std::fill(mDry.begin(), mDry.end(), (T)0);
+    mInputPos = mShapedPos = mDryPos = 0;
+    mResting = true;
+  }
+
+  //Largest magnitude anywhere in the histories
+  T Peak() const
+  {
+    T peak = 0;
+    if (mResting) return peak;
+    for (size_t i=0; i<mInput.size(); i++) peak = std::max(peak, (T)std::fabs(mInput[i]));
+    for (size_t i=0; i<mShaped.size(); i++) peak = std::max(peak, (T)std::fabs(mShaped[i]));
+    for (size_t i=0; i<mDry.size(); i++) peak = std::max(peak, (T)std::fabs(mDry[i]));
+    return peak;
+  }
+
+  //New factor, 1, 2, 4 or 8; shape(T* frame, int nChannels) shapes one frame in place
+  template <typename Shape>
+  void SetFactor(int factor, int nChannels, Shape shape)
+  {
+    if (factor == mFactor) return;
+    mFactor = factor;
+    if (mResting) return;
+
+    //the last kTaps frames again at the new rate, enough for the next decimation
+    const T* newest = &mInput[(mInputPos + kInputLength) * Channels];
+    mShapedPos = 0;
+    for (int back = kTaps - 1; back >= 0; back--) {
+      for (int p=0; p<factor; p++) {
+        T* frame = NextShaped();
+        Interpolate(newest - back * Channels, p, frame, nChannels);
+        shape(frame, nChannels);
+        MirrorShaped(frame, nChannels);
+      }
+    }
+  }
+
+  //One host frame through the shaper: x in and out, dry delayed to match
+  template <typename Shape>
+  inline void Process(T* x, T* dry, int nChannels, Shape shape)
+  {
+    Upsample(x, dry, nChannels, shape);
+    DecimateShaped(x, nChannels);
+  }
+
+  //The same with the shaped frames times gain before they are decimated
+  template <typename Shape>
+  inline void Process(T* x, T* dry, int nChannels, Shape shape, T gain)
+  {
+    Upsample(x, dry, nChannels, shape);
+    Scale(gain, nChannels);
+    DecimateShaped(x, nChannels);
+  }
+
+  //One host frame up and shaped, not decimated: returns its mFactor high rate
+  //frames, oldest first, Channels apart. The dry signal is delayed as in Process.
+  template <typename Shape>
+  inline const T* Upsample(const T* x, T* dry, int nChannels, Shape shape)
+  {
+    mResting = false;
+
+    //the doubled rings keep the newest frames in one piece behind the newest
+    if (++mInputPos == kInputLength) mInputPos = 0;
+    T* newest = &mInput[(mInputPos + kInputLength) * Channels];
+    T* copy = &mInput[mInputPos * Channels];
+    for (int c=0; c<nChannels; c++) newest[c] = copy[c] = x[c];
+
+    for (int p=0; p<mFactor; p++) {
+      T* frame = NextShaped();
+      Interpolate(newest, p, frame, nChannels);
+      shape(frame, nChannels);
+      MirrorShaped(frame, nChannels);
+    }
+
+    DelayDry(dry, nChannels);
+    return &mShaped[(mShapedPos + kShapedLength - (mFactor - 1)) * Channels];
+  }
+
+  //The high rate frames of the last Upsample times gain, in the history too
+  inline void Scale(T gain, int nChannels)
+  {
+    for (int p=0; p<mFactor; p++) {
+      const int pos = mShapedPos - p < 0 ? mShapedPos - p + kShapedLength : mShapedPos - p;
+      T* frame = &mShaped[(pos + kShapedLength) * Channels];
+      T* copy = &mShaped[pos * Channels];
+      for (int c=0; c<nChannels; c++) copy[c] = frame[c] *= gain;
+    }
+  }
+
+  //mFactor high rate frames, Channels apart, decimated to one host frame
+  inline void Decimate(const T* high, T* out, int nChannels)
+  {
+    mResting = false;
+    for (int p=0; p<mFactor; p++) {
+      T* frame = NextShaped();
+      for (int c=0; c<nChannels; c++) frame[c] = high[p * Channels + c];
+      MirrorShaped(frame, nChannels);
+    }
+    DecimateShaped(out, nChannels);
+  }
+
+  //A decimator taking over from count oversamplers at factor: its history
+  //becomes the sum of their shaped histories, their gains already in them
+  void Rebuild(int factor, const OversamplerT* const* sources, int count, int nChannels)
+  {
+    mFactor = factor;
+    mShapedPos = 0;
+    for (int back = kShapedLength - 1; back >= 0; back--) {
+      T* frame = NextShaped();
+      for (int c=0; c<nChannels; c++) frame[c] = 0;
+      for (int i=0; i<count; i++) {
+        const T* x = &sources[i]->mShaped[(sources[i]->mShapedPos + kShapedLength - back) * Channels];
+        for (int c=0; c<nChannels; c++) frame[c] += x[c];
+      }
+      MirrorShaped(frame, nChannels);
+    }
+    mResting = false;
+  }
+
+  //The dry delay alone, for a band that is not shaped
+  inline void DelayDry(T* dry, int nChannels)
+  {
+    mResting = false;
+    T* in = &mDry[mDryPos * Channels];
+    const int out = mDryPos == kLatency ? 0 : mDryPos + 1;
+    for (int c=0; c<nChannels; c++) in[c] = dry[c];
+    for (int c=0; c<nChannels; c++) dry[c] = mDry[out * Channels + c];
+    if (++mDryPos == kLatency + 1) mDryPos = 0;
+  }
+
+private:
+  //Input frames the rebuild reaches back, shaped frames the decimator does
+  enum { kInputLength = 2 * kTaps + 1, kShapedLength = (kTaps + 1) * kMaxFactor };
+
+  inline T* NextShaped()
+  {
+    if (++mShapedPos == kShapedLength) mShapedPos = 0;
+    return &mShaped[(mShapedPos + kShapedLength) * Channels];
+  }
+
+  inline void MirrorShaped(const T* frame, int nChannels)
+  {
+    T* copy = &mShaped[mShapedPos * Channels];
+    for (int c=0; c<nChannels; c++) copy[c] = frame[c];
+  }
+
+  //High rate frame p of the host frame at newest, half the filter behind
+  inline void Interpolate(const T* newest, int p, T* out, int nChannels) const
+  {
+    if (mFactor == 1) {
+      const T* x = newest - (kTaps / 2) * Channels;
+      for (int c=0; c<nChannels; c++) out[c] = x[c];
+      return;
+    }
+    int shift = 0;
+    while ((1 << shift) < mFactor) shift++;
+    const T* h = &mUp[shift][p * (kTaps + 1)];
+    for (int c=0; c<nChannels; c++) {
+      //two sums, so the adds overlap
+      T even = h[0] * newest[c], odd = 0;
+      for (int m=1; m<kTaps; m+=2) {
+        odd += h[m] * newest[c - m * Channels];
+        even += h[m + 1] * newest[c - (m + 1) * Channels];
+      }
+      out[c] = even + odd;
+    }
+  }
+
+  //The host frame from the high rate frames up to the first of the newest host frame
+  inline void DecimateShaped(T* out, int nChannels) const
+  {
+    const T* x = &mShaped[(mShapedPos + kShapedLength - (mFactor - 1)) * Channels];
+    if (mFactor == 1) {
+      x -= (kTaps / 2) * Channels;
+      for (int c=0; c<nChannels; c++) out[c] = x[c];
+      return;
+    }
+    int shift = 0;
+    while ((1 << shift) < mFactor) shift++;
+    const T* g = &mDown[shift][0];
+    const int length = kTaps * mFactor + 1;
+    for (int c=0; c<nChannels; c++) {
+      T even = g[0] * x[c], odd = 0;
+      for (int k=1; k<length; k+=2) {
+        odd += g[k] * x[c - k * Channels];
+        even += g[k + 1] * x[c - (k + 1) * Channels];
+      }
+      out[c] = even + odd;
+    }
+  }
+
+  int mFactor;
+  std::vector<T> mInput;  //[2 * kInputLength][Channels]
+  std::vector<T> mShaped; //[2 * kShapedLength][Channels]
+  std::vector<T> mDry;    //[kLatency + 1][Channels]
+  int mInputPos, mShapedPos, mDryPos;
+  bool mResting;
+  std::vector<T> mUp[4], mDown[4]; //for a factor of 2^i
+};
+
+#endif /* Oversampler_h */
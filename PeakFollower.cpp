@@ -16,6 +16,9 @@ PeakFollower::PeakFollower(double sampleRate){
     output = 0.;
 };
 
+PeakFollower::~PeakFollower(){
+};
+
 float PeakFollower::process(double input){
     input = fabs(input);
 
@@ -8,6 +8,8 @@
 #ifndef RMS_h
 #define RMS_h
 
+#include <math.h>
+
 class RMSFollower
 {
 public:
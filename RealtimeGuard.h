@@ -0,0 +1,60 @@
+//
+//  RealtimeGuard.h
+//  MultibandDistortion
+//
+//  Marks code that runs on the audio thread and must not allocate, lock or
+//  block. Built with RT_SAFETY_CHECKS, a RealtimeScope raises a per-thread depth
+//  for its lifetime, and the interposers in tools/rtcheck report every
+//  allocation, mutex lock and blocking system call made while it is raised.
+//  Without the define both classes do nothing and compile away.
+//
+
+#ifndef RealtimeGuard_h
+#define RealtimeGuard_h
+
+#ifdef RT_SAFETY_CHECKS
+
+inline int& RealtimeDepth() {
+    static thread_local int depth = 0;
+    return depth;
+}
+
+inline bool InRealtimeScope() { return RealtimeDepth() > 0; }
+
+class RealtimeScope {
+public:
+    RealtimeScope() { RealtimeDepth()++; }
+    ~RealtimeScope() { RealtimeDepth()--; }
+};
+
+// Lifts the guard for calls that are known and accepted to block
+class RealtimeExempt {
+public:
+    RealtimeExempt() : mSaved(RealtimeDepth()) { RealtimeDepth() = 0; }
+    ~RealtimeExempt() { RealtimeDepth() = mSaved; }
+
+private:
+    int mSaved;
+};
+
+#else
+
+inline bool InRealtimeScope() { return false; }
+
+//user-declared constructors and destructors, as above, so a scope held only
+//for its lifetime is not reported as an unused variable
+class RealtimeScope {
+public:
+    RealtimeScope() {}
+    ~RealtimeScope() {}
+};
+
+class RealtimeExempt {
+public:
+    RealtimeExempt() {}
+    ~RealtimeExempt() {}
+};
+
+#endif
+
+#endif /* RealtimeGuard_h */
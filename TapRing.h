@@ -0,0 +1,66 @@
+//
+//  TapRing.h
+//  MultibandDistortion
+//
+//  Lock-free hand over of analyzer taps from the audio thread to the analysis.
+//
+
+#ifndef TapRing_h
+#define TapRing_h
+
+#include <atomic>
+#include <vector>
+
+// Single producer / single consumer ring of analysis frames. Every frame holds one float per
+// tap (input, output, band signals...). The audio thread fills frames and publishes them once
+// per block, the GUI thread reads them; only the two positions are shared, so neither side
+// ever waits on the other. When the reader falls behind, new frames are dropped.
+class Spect_TapRing {
+public:
+    Spect_TapRing(const int numtaps, const int sizepow2) {
+        numTaps = numtaps;
+        mask = sizepow2 - 1;
+        vData.resize(sizepow2 * numTaps);
+        writeLocal = 0;
+        readLocal = 0;
+        readCached = 0;
+        writePos.store(0);
+        readPos.store(0);
+    }
+    ~Spect_TapRing() {}
+
+    // audio thread: next frame to fill, 0 if the ring is full
+    float* WriteFrame() {
+        if (writeLocal - readCached > mask) {
+            readCached = readPos.load(std::memory_order_acquire);
+            if (writeLocal - readCached > mask) return 0;
+        }
+        return &vData[(writeLocal++ & mask) * numTaps];
+    }
+
+    // audio thread: makes the frames written since the last call visible to the reader
+    void Publish() { writePos.store(writeLocal, std::memory_order_release); }
+
+    // reader: frames ready to be read
+    int Available() { return (int)(writePos.load(std::memory_order_acquire) - readLocal); }
+
+    const float* ReadFrame(const int i) const { return &vData[((readLocal + i) & mask) * numTaps]; }
+
+    void Consume(const int n) {
+        readLocal += n;
+        readPos.store(readLocal, std::memory_order_release);
+    }
+
+    // reader: drops everything written so far
+    void Discard() { Consume(Available()); }
+
+private:
+    std::vector<float> vData;
+    std::atomic<unsigned int> writePos, readPos;
+    unsigned int writeLocal, readCached; // owned by the writer
+    unsigned int readLocal;              // owned by the reader
+    unsigned int mask;
+    int numTaps;
+};
+
+#endif /* TapRing_h */
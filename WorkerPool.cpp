@@ -0,0 +1,179 @@
+//
+//  WorkerPool.cpp
+//  MultibandDistortion
+//
+
+#include "WorkerPool.h"
+#include "RealtimeGuard.h"
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#ifdef __APPLE__
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#endif
+#endif
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#include <immintrin.h>
+static inline void CpuPause() { _mm_pause(); }
+#elif defined(__aarch64__) || defined(__arm__)
+static inline void CpuPause() { __asm__ __volatile__("yield"); }
+#else
+static inline void CpuPause() {}
+#endif
+
+//How long an idle worker spins before it sleeps
+static const std::chrono::microseconds kSpinTime(200);
+
+//A counting semaphore: Post neither locks nor blocks, Wait sleeps until posted
+class WorkerSemaphore
+{
+public:
+#ifdef _WIN32
+  WorkerSemaphore() : mHandle(CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL)) {}
+  ~WorkerSemaphore() { CloseHandle(mHandle); }
+  void Post(int count) { ReleaseSemaphore(mHandle, count, NULL); }
+  void Wait() { WaitForSingleObject(mHandle, INFINITE); }
+
+private:
+  HANDLE mHandle;
+#elif defined(__APPLE__)
+  //unnamed POSIX semaphores are not implemented on macOS
+  WorkerSemaphore() : mHandle(dispatch_semaphore_create(0)) {}
+  ~WorkerSemaphore() { dispatch_release(mHandle); }
+  void Post(int count) { for (int i=0; i<count; i++) dispatch_semaphore_signal(mHandle); }
+  void Wait() { dispatch_semaphore_wait(mHandle, DISPATCH_TIME_FOREVER); }
+
+private:
+  dispatch_semaphore_t mHandle;
+#else
+  WorkerSemaphore() { sem_init(&mHandle, 0, 0); }
+  ~WorkerSemaphore() { sem_destroy(&mHandle); }
+  void Post(int count) { for (int i=0; i<count; i++) sem_post(&mHandle); }
+  void Wait() { while (sem_wait(&mHandle) != 0 && errno == EINTR) {} }
+
+private:
+  sem_t mHandle;
+#endif
+};
+
+//Close to the top, where hosts put their audio threads; refused without the rights
+static void SetRealtimePriority()
+{
+#ifdef _WIN32
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#else
+  sched_param param;
+  param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 10;
+  pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#endif
+}
+
+WorkerPool::WorkerPool(int numWorkers):
+  mJob(0), mDone(0), mTask(0), mContext(0), mGeneration(0), mSleeping(0), mWakeup(new WorkerSemaphore), mQuit(false)
+{
+  for (int i=0; i<numWorkers; i++) {
+    mWorkers.push_back(std::thread(&WorkerPool::WorkerMain, this));
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  mQuit.store(true);
+  WakeSleepers();
+  for (size_t i=0; i<mWorkers.size(); i++) mWorkers[i].join();
+  delete mWakeup;
+}
+
+void WorkerPool::Run(Task task, void* context, int count)
+{
+  if (count <= 0) return;
+  if (count > 0xFFFF) count = 0xFFFF;
+
+  //every task of the last job has finished, nobody reads these until the job is published
+  mTask = task;
+  mContext = context;
+  mDone.store(0, std::memory_order_relaxed);
+  mJob.store(Pack(++mGeneration, count, 0));
+
+  //workers that are asleep or on their way there; a worker that registers after
+  //this sees the job itself
+  WakeSleepers();
+
+  RunTasks();
+  while (mDone.load(std::memory_order_acquire) < count) CpuPause();
+}
+
+//One post for every worker registered to sleep, the registrations cleared
+void WorkerPool::WakeSleepers()
+{
+  if (mSleeping.load() == 0) return;
+  const int sleeping = mSleeping.exchange(0);
+  if (sleeping > 0) mWakeup->Post(sleeping);
+}
+
+bool WorkerPool::JobPending() const
+{
+  const unsigned long long job = mJob.load();
+  return (job & 0xFFFF) < ((job >> 16) & 0xFFFF);
+}
+
+//Claims and runs tasks of the current job until none are left, true if it ran any
+bool WorkerPool::RunTasks()
+{
+  bool ran = false;
+  unsigned long long job = mJob.load(std::memory_order_acquire);
+  for (;;) {
+    const int count = (int)((job >> 16) & 0xFFFF);
+    const int next = (int)(job & 0xFFFF);
+    if (next >= count) return ran;
+    if (mJob.compare_exchange_weak(job, job + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+      mTask(mContext, next);
+      mDone.fetch_add(1, std::memory_order_release);
+      ran = true;
+      job = mJob.load(std::memory_order_acquire);
+    }
+  }
+}
+
+void WorkerPool::WorkerMain()
+{
+  SetRealtimePriority();
+
+  std::chrono::steady_clock::time_point idleSince = std::chrono::steady_clock::now();
+  while (!mQuit.load()) {
+    bool ran;
+    {
+      //the tasks are audio thread code
+      RealtimeScope realtime;
+      ran = RunTasks();
+    }
+    if (ran) {
+      idleSince = std::chrono::steady_clock::now();
+      continue;
+    }
+    if (std::chrono::steady_clock::now() - idleSince < kSpinTime) {
+      CpuPause();
+      continue;
+    }
+
+    //registered first, then the job looked at again: a job published before the
+    //registration is seen here, one published after it posts the semaphore
+    mSleeping.fetch_add(1);
+    if (JobPending() || mQuit.load()) {
+      //the registration taken back, or the post Run already counted for it taken
+      int sleeping = mSleeping.load();
+      while (sleeping > 0 && !mSleeping.compare_exchange_weak(sleeping, sleeping - 1)) {}
+      if (sleeping == 0) mWakeup->Wait();
+    }
+    else mWakeup->Wait();
+    idleSince = std::chrono::steady_clock::now();
+  }
+}
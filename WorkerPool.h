@@ -0,0 +1,67 @@
+//
+//  WorkerPool.h
+//  MultibandDistortion
+//
+//  A few worker threads that help the audio thread through a block: Run()
+//  hands out count tasks, runs as many of them itself as it gets to, and
+//  returns when all are done. Tasks are claimed from one shared atomic counter,
+//  so whichever thread is free takes the next one and nobody waits on a queue.
+//
+//  The audio thread side allocates, locks and blocks nothing: it publishes the
+//  job with an atomic store, posts a semaphore once per sleeping worker and spins
+//  for the tasks the workers took. Workers spin for a while after a job before
+//  they go to sleep, so back to back blocks find them awake. Asleep they wait on
+//  the semaphore alone, with no timeout, so an idle pool costs nothing. They ask
+//  for real-time priority, which the system may refuse.
+//
+
+#ifndef WorkerPool_h
+#define WorkerPool_h
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+class WorkerSemaphore;
+
+class WorkerPool
+{
+public:
+  typedef void (*Task)(void* context, int index);
+
+  WorkerPool(int numWorkers);
+  ~WorkerPool();
+
+  int GetNumWorkers() const { return (int)mWorkers.size(); }
+
+  //Runs task(context, i) for every i in [0, count) on the workers and the
+  //calling thread, returns when all of them have finished. Audio thread only,
+  //one Run at a time.
+  void Run(Task task, void* context, int count);
+
+private:
+  void WorkerMain();
+  bool RunTasks();
+  bool JobPending() const;
+  void WakeSleepers();
+
+  //job: generation in the high 32 bits, task count and next task in 16 bits each
+  static unsigned long long Pack(unsigned int generation, int count, int next)
+  {
+    return ((unsigned long long)generation << 32) | ((unsigned long long)count << 16) | (unsigned long long)next;
+  }
+
+  std::atomic<unsigned long long> mJob;
+  std::atomic<int> mDone;
+  Task mTask;
+  void* mContext;
+  unsigned int mGeneration;
+
+  std::vector<std::thread> mWorkers;
+  //workers registered to sleep that no post has been counted for yet
+  std::atomic<int> mSleeping;
+  WorkerSemaphore* mWakeup;
+  std::atomic<bool> mQuit;
+};
+
+#endif /* WorkerPool_h */
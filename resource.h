@@ -43,7 +43,7 @@
 instrument determined by PLUG _IS _INST
 */
 
-#define PLUG_CHANNEL_IO "1-1 2-2"
+#define PLUG_CHANNEL_IO "1-1 2-2 4-4 6-6 8-8 10-10 12-12 16-16"
 
 #define PLUG_LATENCY 0
 #define PLUG_IS_INST 0
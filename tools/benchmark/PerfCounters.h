@@ -0,0 +1,149 @@
+//
+//  PerfCounters.h
+//  MultibandDistortion
+//
+//  Hardware performance counters for the benchmark regions, through Linux
+//  perf_event_open: cycles, instructions, L1 data cache read misses, last level
+//  cache misses, branch mispredictions and floating point assists (the microcode
+//  assists taken on denormal operands and results).
+//
+//  FP assists have no generic perf event; they are read as a raw event, by
+//  default Intel's FP_ASSIST.ANY (0x1eca, Sandy Bridge to Skylake). Ice Lake and
+//  later count them as ASSISTS.FP (0x02c1). On other CPUs the counter stays off
+//  unless a raw event is given explicitly.
+//
+//  Counters are opened independently and scaled by their running time, so the
+//  kernel may multiplex them. Anything the kernel refuses (no PMU in a VM,
+//  perf_event_paranoid, other platforms) reads as unavailable.
+//
+
+#ifndef PerfCounters_h
+#define PerfCounters_h
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+class PerfCounters {
+public:
+    enum ECounter { kCycles = 0, kInstructions, kL1DMisses, kLLCMisses, kBranchMisses, kFPAssists, kNumCounters };
+
+    static const char* Name(const int counter) {
+        static const char* names[kNumCounters] = { "cycles", "instructions", "L1D misses", "LLC misses", "branch misses", "FP assists" };
+        return names[counter];
+    }
+
+    PerfCounters() {
+        for (int i = 0; i < kNumCounters; i++) {
+            mFd[i] = -1;
+            mTotal[i] = 0.;
+        }
+    }
+
+    ~PerfCounters() { Close(); }
+
+    // fpAssistEvent: raw event for the FP assist counter, 0 picks the default for this CPU.
+    // Returns false if no counter at all could be opened.
+    bool Open(unsigned long long fpAssistEvent = 0) {
+        Close();
+#ifdef __linux__
+        OpenCounter(kCycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        OpenCounter(kInstructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        OpenCounter(kL1DMisses, PERF_TYPE_HW_CACHE,
+                    PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        OpenCounter(kLLCMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        OpenCounter(kBranchMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        if (!fpAssistEvent && IsIntel()) fpAssistEvent = 0x1eca;
+        if (fpAssistEvent) OpenCounter(kFPAssists, PERF_TYPE_RAW, fpAssistEvent);
+#else
+        (void)fpAssistEvent;
+#endif
+        for (int i = 0; i < kNumCounters; i++) {
+            if (mFd[i] >= 0) return true;
+        }
+        return false;
+    }
+
+    void Close() {
+#ifdef __linux__
+        for (int i = 0; i < kNumCounters; i++) {
+            if (mFd[i] >= 0) close(mFd[i]);
+            mFd[i] = -1;
+        }
+#endif
+    }
+
+    bool IsAvailable(const int counter) const { return mFd[counter] >= 0; }
+
+    void Reset() {
+        for (int i = 0; i < kNumCounters; i++) mTotal[i] = 0.;
+    }
+
+    // counting between Start() and Stop() is added to the totals
+    void Start() {
+#ifdef __linux__
+        for (int i = 0; i < kNumCounters; i++) {
+            if (mFd[i] < 0) continue;
+            ioctl(mFd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(mFd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    void Stop() {
+#ifdef __linux__
+        for (int i = 0; i < kNumCounters; i++) {
+            if (mFd[i] < 0) continue;
+            ioctl(mFd[i], PERF_EVENT_IOC_DISABLE, 0);
+            unsigned long long values[3]; // value, time enabled, time running
+            if (read(mFd[i], values, sizeof(values)) != (ssize_t)sizeof(values) || !values[2]) continue;
+            mTotal[i] += (double)values[0] * ((double)values[1] / (double)values[2]);
+        }
+#endif
+    }
+
+    double Total(const int counter) const { return mTotal[counter]; }
+
+private:
+#ifdef __linux__
+    void OpenCounter(const int counter, const unsigned int type, const unsigned long long config) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        mFd[counter] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    static bool IsIntel() {
+        FILE* f = fopen("/proc/cpuinfo", "r");
+        if (!f) return false;
+        char line[256];
+        bool intel = false;
+        while (fgets(line, sizeof(line), f)) {
+            if (!strncmp(line, "vendor_id", 9)) {
+                intel = strstr(line, "GenuineIntel") != 0;
+                break;
+            }
+        }
+        fclose(f);
+        return intel;
+    }
+#endif
+
+    int mFd[kNumCounters];
+    double mTotal[kNumCounters];
+};
+
+#endif /* PerfCounters_h */
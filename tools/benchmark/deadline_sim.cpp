@@ -0,0 +1,284 @@
+//
+//  deadline_sim.cpp
+//  MultibandDistortion
+//
+//  Real-time deadline simulator. Drives MultibandEngine the way a host's audio
+//  thread does: fixed buffer sizes, one block per buffer period, on a thread
+//  pinned to one CPU. Every block's processing time is recorded and reported as
+//  p50 / p99 / p99.9 / max against the buffer deadline, with a histogram.
+//
+//  Besides continuous drive/mix automation, a script fires the discrete changes
+//  that are suspected of causing crackles: crossover moves (filter coefficient
+//  recalculation), mode switches, link toggles, solo toggles and the analyzer
+//  being switched on and off. Blocks where the thread was preempted or took page
+//  faults are marked too. For the slowest blocks, the report shows how often
+//  each event coincided with them compared to how often it happens overall.
+//
+//  The spectrum analysis itself runs on the GUI thread and is not part of the
+//  audio thread's deadline; with the analyzer on, a reader thread empties the
+//  tap ring at the editor's frame rate.
+//
+//  Command line:
+//    --seconds=<n>      simulated time per buffer size (default 20)
+//    --rate=<hz>        sample rate (default 44100)
+//    --buffers=<list>   comma separated buffer sizes (default 32,64,128,256)
+//    --cpu=<n>          CPU to pin the audio thread to (default: the last one)
+//    --fifo             request SCHED_FIFO for the audio thread (needs privileges)
+//    --freerun          do not wait for the buffer period, process back to back
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#endif
+
+#include "MultibandEngine.h"
+#include "ProgramMaterial.h"
+
+//the script's events, then what the thread itself ran into
+enum EEvents
+{
+  kEventPreempted = kNumScriptEvents,
+  kEventPageFault,
+  kNumEvents
+};
+
+static const char* eventNames[kNumEvents] =
+{
+  "crossover moved", "mode switched", "link toggled", "solo toggled", "analyzer toggled", "preempted", "page fault"
+};
+
+struct SimOptions
+{
+  double seconds, sampleRate;
+  std::vector<int> buffers;
+  int cpu;
+  bool fifo, freerun;
+};
+
+struct BlockRecord
+{
+  double duration;
+  unsigned int events;
+};
+
+#ifdef __linux__
+static void GetThreadUsage(long& involuntarySwitches, long& pageFaults)
+{
+  struct rusage usage;
+  getrusage(RUSAGE_THREAD, &usage);
+  involuntarySwitches = usage.ru_nivcsw;
+  pageFaults = usage.ru_minflt + usage.ru_majflt;
+}
+#endif
+
+static void SetupAudioThread(const SimOptions& options)
+{
+#ifdef __linux__
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(options.cpu, &cpus);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+    fprintf(stderr, "could not pin the audio thread to CPU %d\n", options.cpu);
+  }
+  if (options.fifo) {
+    struct sched_param param;
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+      fprintf(stderr, "could not switch the audio thread to SCHED_FIFO\n");
+    }
+  }
+#else
+  (void)options;
+#endif
+}
+
+static void RunAudioThread(const SimOptions& options, int blockSize, std::vector<BlockRecord>& records)
+{
+  SetupAudioThread(options);
+
+  const int nChannels = 2;
+  MultibandEngine engine(options.sampleRate);
+  ProgramMaterial material(options.sampleRate);
+  AutomationScript automation(options.sampleRate);
+  EventScript events(options.sampleRate);
+
+  Spect_TapRing ring(kNumTaps, 1 << 14);
+  std::atomic<bool> running(true);
+  std::thread editor([&]() {
+    while (running.load()) {
+      ring.Discard();
+      std::this_thread::sleep_for(std::chrono::milliseconds(16));
+    }
+  });
+
+  std::vector<double> in[2], out[2];
+  double* inputs[2];
+  double* outputs[2];
+  for (int c=0; c<nChannels; c++) {
+    in[c].resize(blockSize);
+    out[c].resize(blockSize);
+    inputs[c] = &in[c][0];
+    outputs[c] = &out[c][0];
+  }
+
+  const long long total = (long long)(options.seconds * options.sampleRate);
+  const std::chrono::nanoseconds period((long long)(1e9 * blockSize / options.sampleRate));
+  records.clear();
+  records.reserve((size_t)(total / blockSize + 1));
+
+  std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+  for (long long pos = 0; pos < total; pos += blockSize) {
+    //the host's input arrives between callbacks
+    material.Render(inputs, nChannels, blockSize);
+    if (!options.freerun) {
+      next += period;
+      std::this_thread::sleep_until(next);
+    }
+
+    BlockRecord record;
+#ifdef __linux__
+    long switchesBefore, faultsBefore, switchesAfter, faultsAfter;
+    GetThreadUsage(switchesBefore, faultsBefore);
+#endif
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    automation.Apply(engine, pos);
+    record.events = events.Apply(engine, &ring, pos);
+    engine.ProcessBlock(inputs, outputs, nChannels, blockSize);
+    record.duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+#ifdef __linux__
+    GetThreadUsage(switchesAfter, faultsAfter);
+    if (switchesAfter != switchesBefore) record.events |= 1u << kEventPreempted;
+    if (faultsAfter != faultsBefore) record.events |= 1u << kEventPageFault;
+#endif
+    records.push_back(record);
+  }
+
+  running.store(false);
+  editor.join();
+}
+
+static double Percentile(const std::vector<double>& sorted, double p)
+{
+  const size_t i = std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5));
+  return sorted[i];
+}
+
+static void Report(const std::vector<BlockRecord>& records, int blockSize, double sampleRate)
+{
+  const double deadline = blockSize / sampleRate;
+  std::vector<double> sorted(records.size());
+  for (size_t i = 0; i < records.size(); i++) sorted[i] = records[i].duration;
+  std::sort(sorted.begin(), sorted.end());
+
+  const double p50 = Percentile(sorted, 0.5), p99 = Percentile(sorted, 0.99), p999 = Percentile(sorted, 0.999), max = sorted.back();
+  printf("\n%d samples, deadline %.1f us, %d blocks\n", blockSize, 1e6 * deadline, (int)records.size());
+  printf("  p50 %9.2f us %7.2f%%\n", 1e6 * p50, 100. * p50 / deadline);
+  printf("  p99 %9.2f us %7.2f%%\n", 1e6 * p99, 100. * p99 / deadline);
+  printf("  p99.9 %7.2f us %7.2f%%\n", 1e6 * p999, 100. * p999 / deadline);
+  printf("  max %9.2f us %7.2f%%\n", 1e6 * max, 100. * max / deadline);
+
+  //histogram in fractions of the deadline
+  static const double edges[] = { 0.01, 0.02, 0.05, 0.1, 0.25, 0.5, 0.75, 1. };
+  const int numEdges = sizeof(edges) / sizeof(edges[0]);
+  int counts[numEdges + 1] = { 0 };
+  for (size_t i = 0; i < sorted.size(); i++) {
+    int b = 0;
+    while (b < numEdges && sorted[i] >= edges[b] * deadline) b++;
+    counts[b]++;
+  }
+  printf("  histogram (share of the deadline):\n");
+  for (int b = 0; b <= numEdges; b++) {
+    if (!counts[b]) continue;
+    char label[32];
+    if (b == 0) snprintf(label, sizeof(label), "< %g%%", 100. * edges[0]);
+    else if (b == numEdges) snprintf(label, sizeof(label), ">= %g%%", 100. * edges[numEdges - 1]);
+    else snprintf(label, sizeof(label), "%g-%g%%", 100. * edges[b - 1], 100. * edges[b]);
+    printf("    %-10s %8d %8.3f%%\n", label, counts[b], 100. * counts[b] / sorted.size());
+  }
+
+  //events behind the slowest blocks: everything at or above p99.9, and anything over the deadline
+  const double threshold = std::min(p999, deadline);
+  int outliers = 0, overruns = 0;
+  int all[kNumEvents] = { 0 }, slow[kNumEvents] = { 0 };
+  for (size_t i = 0; i < records.size(); i++) {
+    const bool isSlow = records[i].duration >= threshold;
+    outliers += isSlow;
+    overruns += records[i].duration > deadline;
+    for (int e = 0; e < kNumEvents; e++) {
+      if ((records[i].events >> e) & 1) {
+        all[e]++;
+        slow[e] += isSlow;
+      }
+    }
+  }
+  printf("  %d block(s) over the deadline\n", overruns);
+  printf("  events in the %d slowest blocks (>= %.2f us) vs. all blocks:\n", outliers, 1e6 * threshold);
+  for (int e = 0; e < kNumEvents; e++) {
+    printf("    %-18s %8.2f%% %8.2f%%\n", eventNames[e], outliers ? 100. * slow[e] / outliers : 0., 100. * all[e] / records.size());
+  }
+}
+
+static bool ParseBuffers(const char* list, std::vector<int>& buffers)
+{
+  buffers.clear();
+  while (*list) {
+    const int n = atoi(list);
+    if (n <= 0) return false;
+    buffers.push_back(n);
+    list = strchr(list, ',');
+    if (!list) break;
+    list++;
+  }
+  return !buffers.empty();
+}
+
+int main(int argc, char** argv)
+{
+  SimOptions options;
+  options.seconds = 20.;
+  options.sampleRate = 44100.;
+  ParseBuffers("32,64,128,256", options.buffers);
+  options.cpu = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+  options.fifo = false;
+  options.freerun = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strncmp(argv[i], "--seconds=", 10)) options.seconds = atof(argv[i] + 10);
+    else if (!strncmp(argv[i], "--rate=", 7)) options.sampleRate = atof(argv[i] + 7);
+    else if (!strncmp(argv[i], "--buffers=", 10) && ParseBuffers(argv[i] + 10, options.buffers)) {}
+    else if (!strncmp(argv[i], "--cpu=", 6)) options.cpu = atoi(argv[i] + 6);
+    else if (!strcmp(argv[i], "--fifo")) options.fifo = true;
+    else if (!strcmp(argv[i], "--freerun")) options.freerun = true;
+    else {
+      fprintf(stderr, "usage: %s [--seconds=<n>] [--rate=<hz>] [--buffers=<list>] [--cpu=<n>] [--fifo] [--freerun]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (options.seconds <= 0. || options.sampleRate <= 0.) {
+    fprintf(stderr, "seconds and rate must be positive\n");
+    return 1;
+  }
+
+  printf("%.0f s per buffer size at %.0f Hz, audio thread on CPU %d%s%s\n", options.seconds, options.sampleRate, options.cpu,
+         options.fifo ? ", SCHED_FIFO" : "", options.freerun ? ", free running" : "");
+  for (size_t b = 0; b < options.buffers.size(); b++) {
+    std::vector<BlockRecord> records;
+    std::thread audio(RunAudioThread, std::cref(options), options.buffers[b], std::ref(records));
+    audio.join();
+    Report(records, options.buffers[b], options.sampleRate);
+    fflush(stdout);
+  }
+  return 0;
+}
@@ -0,0 +1,279 @@
+//
+//  dsp_benchmarks.cpp
+//  MultibandDistortion
+//
+//  Microbenchmarks for the plugin's DSP building blocks. Every case processes one
+//  block of deterministic noise per iteration, for block sizes 16..4096 (the FFT
+//  runs every supported transform size instead), and reports ns per sample.
+//  In-place processors copy their input back every iteration so the signal never
+//  decays into denormals; the copy is part of the measured time.
+//
+
+#include <vector>
+#include <cstring>
+
+#include "microbench.h"
+
+#include "LinkwitzRiley.h"
+#include "DenormalGuard.h"
+#include "Distortion.h"
+#include "WaveshaperTables.h"
+#include "CParamSmooth.h"
+#include "PeakFollower.h"
+#include "RMS.h"
+#include "CFxRbjFilter.h"
+#include "VAStateVariableFilter.h"
+#include "fft.h"
+
+#ifdef HAVE_WDL
+#define WDL_BESSEL_FILTER_ORDER 8
+#define WDL_BESSEL_DENORMAL_AGGRESSIVE
+#include "besselfilter.h"
+#endif
+
+static const double kSampleRate = 44100.;
+
+// white noise in [-gain, gain], the same sequence on every run
+template <class T> static std::vector<T> Noise(const int n, const double gain) {
+    std::vector<T> v(n);
+    unsigned int seed = 0x12345678;
+    for (int i = 0; i < n; i++) {
+        seed = seed * 1664525 + 1013904223;
+        v[i] = (T)(gain * ((double)(seed >> 8) / (double)(1 << 23) - 1.));
+    }
+    return v;
+}
+
+static void BM_LinkwitzRiley(BenchState& state) {
+    const int n = state.range(0);
+    const std::vector<double> in = Noise<double>(n, 1.);
+    std::vector<double> out(n);
+    LinkwitzRiley filter(kSampleRate, Lowpass, 1000.);
+    while (state.KeepRunning()) {
+        for (int s = 0; s < n; s++) out[s] = filter.process(in[s], 0);
+        DoNotOptimize(out[n - 1]);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_LinkwitzRiley)->RangeMultiplier(2)->Range(16, 4096);
+
+// input at the bottom of the normal range, so the filter state is denormal: with
+// --counters this shows up as FP assists
+static void BM_LinkwitzRileyDenormal(BenchState& state) {
+    const int n = state.range(0);
+    const std::vector<double> in = Noise<double>(n, 1e-305);
+    std::vector<double> out(n);
+    LinkwitzRiley filter(kSampleRate, Lowpass, 1000.);
+    while (state.KeepRunning()) {
+        for (int s = 0; s < n; s++) out[s] = filter.process(in[s], 0);
+        DoNotOptimize(out[n - 1]);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_LinkwitzRileyDenormal)->RangeMultiplier(2)->Range(16, 4096);
+
+// the same input with denormals flushed to zero, as the engine runs the filterbank
+static void BM_LinkwitzRileyDenormalFlushed(BenchState& state) {
+    const int n = state.range(0);
+    const std::vector<double> in = Noise<double>(n, 1e-305);
+    std::vector<double> out(n);
+    LinkwitzRiley filter(kSampleRate, Lowpass, 1000.);
+    FlushDenormalsScope flushDenormals;
+    while (state.KeepRunning()) {
+        for (int s = 0; s < n; s++) out[s] = filter.process(in[s], 0);
+        DoNotOptimize(out[n - 1]);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_LinkwitzRileyDenormalFlushed)->RangeMultiplier(2)->Range(16, 4096);
+
+// a frame of every channel at once, as the engine runs it; items are samples of
+// all channels, so per item cost against BM_LinkwitzRiley shows the SIMD gain
+static void BM_LinkwitzRileyFrame(BenchState& state, const int channels) {
+    const int n = state.range(0);
+    const std::vector<double> in = Noise<double>(n * channels, 1.);
+    std::vector<double> out(n * channels);
+    LinkwitzRiley filter(kSampleRate, Lowpass, 1000.);
+    while (state.KeepRunning()) {
+        for (int s = 0; s < n; s++) filter.processFrame(&in[s * channels], &out[s * channels], channels);
+        DoNotOptimize(out[n * channels - 1]);
+    }
+    state.SetItemsProcessed(state.iterations() * n * channels);
+}
+BENCHMARK_CAPTURE(BM_LinkwitzRileyFrame, 2ch, 2)->RangeMultiplier(2)->Range(16, 4096);
+BENCHMARK_CAPTURE(BM_LinkwitzRileyFrame, 8ch, 8)->RangeMultiplier(2)->Range(16, 4096);
+BENCHMARK_CAPTURE(BM_LinkwitzRileyFrame, 16ch, 16)->RangeMultiplier(2)->Range(16, 4096);
+
+// input is driven well into the shapers' nonlinear range
+static void BM_Distortion(BenchState& state, const int mode) {
+    const int n = state.range(0);
+    const std::vector<double> in = Noise<double>(n, 4.);
+    std::vector<double> out(n);
+    while (state.KeepRunning()) {
+        for (int s = 0; s < n; s++) out[s] = ProcessDistortion(in[s], mode);
+        DoNotOptimize(out[n - 1]);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK_CAPTURE(BM_Distortion, Excite, DistExcite)->RangeMultiplier(2)->Range(16, 4096);
+BENCHMARK_CAPTURE(BM_Distortion, Fat, DistFat)->RangeMultiplier(2)->Range(16, 4096);
+BENCHMARK_CAPTURE(BM_Distortion, Sine, DistSine)->RangeMultiplier(2)->Range(16, 4096);
+BENCHMARK_CAPTURE(BM_Distortion, Fold, DistFold)->RangeMultiplier(2)->Range(16, 4096);
+BENCHMARK_CAPTURE(BM_Distortion, Tanh, DistTanh)->RangeMultiplier(2)->Range(16, 4096);
+BENCHMARK_CAPTURE(BM_Distortion, Soft, DistSoft)->RangeMultiplier(2)->Range(16, 4096);
+BENCHMARK_CAPTURE(BM_Distortion, Cheby, DistChebyshev)->RangeMultiplier(2)->Range(16, 4096);
+
+// the block versions the engine runs, exact and from the tables
+static void BM_DistortionBlock(BenchState& state, const int mode, const bool fast) {
+    const int n = state.range(0);
+    const std::vector<double> in = Noise<double>(n, 4.);
+    std::vector<double> out(n);
+    while (state.KeepRunning()) {
+        std::memcpy(&out[0], &in[0], n * sizeof(double));
+        if (fast) ProcessDistortionFast(&out[0], n, mode);
+        else ProcessDistortion(&out[0], n, mode);
+        DoNotOptimize(out[n - 1]);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK_CAPTURE(BM_DistortionBlock, Sine, DistSine, false)->RangeMultiplier(2)->Range(16, 4096);
+BENCHMARK_CAPTURE(BM_DistortionBlock, SineFast, DistSine, true)->RangeMultiplier(2)->Range(16, 4096);
+BENCHMARK_CAPTURE(BM_DistortionBlock, Fold, DistFold, false)->RangeMultiplier(2)->Range(16, 4096);
+BENCHMARK_CAPTURE(BM_DistortionBlock, FoldFast, DistFold, true)->RangeMultiplier(2)->Range(16, 4096);
+BENCHMARK_CAPTURE(BM_DistortionBlock, Tanh, DistTanh, false)->RangeMultiplier(2)->Range(16, 4096);
+BENCHMARK_CAPTURE(BM_DistortionBlock, TanhFast, DistTanh, true)->RangeMultiplier(2)->Range(16, 4096);
+
+// a different mode on every sample: the mode dispatch can not be predicted
+static void BM_DistortionModeMix(BenchState& state) {
+    const int n = state.range(0);
+    const std::vector<double> in = Noise<double>(n, 4.);
+    std::vector<int> modes(n);
+    unsigned int seed = 0x87654321;
+    for (int s = 0; s < n; s++) {
+        seed = seed * 1664525 + 1013904223;
+        modes[s] = (int)((seed >> 16) % NumDistortionModes);
+    }
+    std::vector<double> out(n);
+    while (state.KeepRunning()) {
+        for (int s = 0; s < n; s++) out[s] = ProcessDistortion(in[s], modes[s]);
+        DoNotOptimize(out[n - 1]);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_DistortionModeMix)->RangeMultiplier(2)->Range(16, 4096);
+
+// the target jumps every block, like a parameter being automated
+static void BM_CParamSmooth(BenchState& state) {
+    const int n = state.range(0);
+    std::vector<double> out(n);
+    CParamSmooth smoother(5.0, kSampleRate);
+    double target = 0.;
+    while (state.KeepRunning()) {
+        target = 1. - target;
+        for (int s = 0; s < n; s++) out[s] = smoother.process(target);
+        DoNotOptimize(out[n - 1]);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_CParamSmooth)->RangeMultiplier(2)->Range(16, 4096);
+
+static void BM_PeakFollower(BenchState& state) {
+    const int n = state.range(0);
+    const std::vector<double> in = Noise<double>(n, 1.);
+    std::vector<double> out(n);
+    PeakFollower follower(kSampleRate);
+    while (state.KeepRunning()) {
+        for (int s = 0; s < n; s++) out[s] = follower.process(in[s]);
+        DoNotOptimize(out[n - 1]);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_PeakFollower)->RangeMultiplier(2)->Range(16, 4096);
+
+static void BM_RMSFollower(BenchState& state) {
+    const int n = state.range(0);
+    const std::vector<double> in = Noise<double>(n, 1.);
+    std::vector<double> out(n);
+    RMSFollower follower;
+    while (state.KeepRunning()) {
+        for (int s = 0; s < n; s++) out[s] = follower.getRMS(in[s], 0);
+        DoNotOptimize(out[n - 1]);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_RMSFollower)->RangeMultiplier(2)->Range(16, 4096);
+
+#ifdef HAVE_WDL
+// the plugin's anti-alias filter for 8x oversampling
+static void BM_BesselFilterStage(BenchState& state) {
+    const int n = state.range(0);
+    const std::vector<double> in = Noise<double>(n, 1.);
+    std::vector<double> out(n);
+    WDL_BesselFilterCoeffs coeffs;
+    coeffs.Calc(0.5 / 8.);
+    WDL_BesselFilterStage stage;
+    stage.Reset();
+    while (state.KeepRunning()) {
+        for (int s = 0; s < n; s++) {
+            stage.Process(in[s], coeffs.Coeffs());
+            out[s] = stage.Output();
+        }
+        DoNotOptimize(out[n - 1]);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_BesselFilterStage)->RangeMultiplier(2)->Range(16, 4096);
+#endif
+
+static void BM_VAStateVariableFilter(BenchState& state) {
+    const int n = state.range(0);
+    const std::vector<float> in = Noise<float>(n, 1.);
+    std::vector<float> buffer(n);
+    VAStateVariableFilter filter;
+    filter.setSampleRate((float)kSampleRate);
+    filter.setFilter(SVFLowpass, 1000.f, 0.5f, 0.f);
+    while (state.KeepRunning()) {
+        memcpy(&buffer[0], &in[0], n * sizeof(float));
+        filter.processAudioBlock(&buffer[0], n, 0);
+        DoNotOptimize(buffer[n - 1]);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_VAStateVariableFilter)->RangeMultiplier(2)->Range(16, 4096);
+
+static void BM_CFxRbjFilter(BenchState& state) {
+    const int n = state.range(0);
+    const std::vector<float> in = Noise<float>(n, 1.);
+    std::vector<float> out(n);
+    CFxRbjFilter filter;
+    filter.calc_filter_coeffs(allpass, 1000, kSampleRate, .5, 0, false);
+    while (state.KeepRunning()) {
+        for (int s = 0; s < n; s++) out[s] = filter.process(in[s]);
+        DoNotOptimize(out[n - 1]);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_CFxRbjFilter)->RangeMultiplier(2)->Range(16, 4096);
+
+// forward complex transform, items are points
+static void BM_WDL_fft(BenchState& state) {
+    const int n = state.range(0);
+    const std::vector<float> re = Noise<float>(n, 1.);
+    std::vector<WDL_FFT_COMPLEX> in(n), buffer(n);
+    for (int i = 0; i < n; i++) {
+        in[i].re = re[i];
+        in[i].im = 0.f;
+    }
+    WDL_fft_init();
+    while (state.KeepRunning()) {
+        memcpy(&buffer[0], &in[0], n * sizeof(WDL_FFT_COMPLEX));
+        WDL_fft(&buffer[0], n, 0);
+        DoNotOptimize(buffer[0]);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_WDL_fft)->RangeMultiplier(2)->Range(16, 32768);
+
+int main(int argc, char** argv) {
+    return RunBenchmarks(argc, argv);
+}
@@ -0,0 +1,227 @@
+//
+//  microbench.h
+//  MultibandDistortion
+//
+//  A small, self-contained benchmark harness with the shape of Google Benchmark
+//  (BENCHMARK(fn)->Range(lo, hi), state.KeepRunning(), SetItemsProcessed), so the
+//  cases can move to the real library unchanged if it ever becomes a dependency.
+//
+//  Every case is run with growing iteration counts until one run takes at least
+//  --min_time seconds; that run is reported as ns per iteration and ns per item
+//  (items are samples for the DSP cases).
+//
+//  Command line:
+//    --filter=<substring>   only run cases whose name contains <substring>
+//    --min_time=<seconds>   minimum measured time per case (default 0.2)
+//    --csv                  comma separated output
+//    --counters             also collect hardware counters (PerfCounters.h), shown
+//                           per item, misses and assists per 1000 items
+//    --fp_assist=<hex>      raw perf event used for the FP assist counter
+//
+
+#ifndef microbench_h
+#define microbench_h
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "PerfCounters.h"
+
+template <class T> inline void DoNotOptimize(T const& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+inline void ClobberMemory() {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : : "memory");
+#endif
+}
+
+class BenchState {
+public:
+    BenchState(const int arg, const long long iterations, PerfCounters* counters = 0)
+        : mArg(arg), mIterations(iterations), mRemaining(iterations), mItems(0), mStarted(false), mSeconds(0.), mCounters(counters) {}
+
+    // the case's argument (block size, fft size...)
+    int range(const int /*i*/ = 0) const { return mArg; }
+
+    long long iterations() const { return mIterations; }
+
+    // timing starts with the first call, so setup before the loop is not measured
+    bool KeepRunning() {
+        if (!mStarted) {
+            mStarted = true;
+            if (mCounters) {
+                mCounters->Reset();
+                mCounters->Start();
+            }
+            mStart = std::chrono::steady_clock::now();
+        }
+        if (mRemaining-- > 0) return true;
+        mSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+        if (mCounters) mCounters->Stop();
+        return false;
+    }
+
+    void SetItemsProcessed(const long long items) { mItems = items; }
+
+    long long ItemsProcessed() const { return mItems; }
+    double Seconds() const { return mSeconds; }
+
+private:
+    int mArg;
+    long long mIterations, mRemaining, mItems;
+    bool mStarted;
+    double mSeconds;
+    PerfCounters* mCounters;
+    std::chrono::steady_clock::time_point mStart;
+};
+
+class BenchCase {
+public:
+    BenchCase(const std::string& name, std::function<void(BenchState&)> fn)
+        : mName(name), mFunction(fn), mMultiplier(8) {}
+
+    BenchCase* Arg(const int a) { mArgs.push_back(a); return this; }
+
+    BenchCase* RangeMultiplier(const int m) { mMultiplier = m; return this; }
+
+    // lo, lo*multiplier, ... up to and including hi
+    BenchCase* Range(const int lo, const int hi) {
+        for (long long a = lo; a < hi; a *= mMultiplier) mArgs.push_back((int)a);
+        mArgs.push_back(hi);
+        return this;
+    }
+
+    const std::string& Name() const { return mName; }
+    const std::vector<int>& Args() const { return mArgs; }
+    void Run(BenchState& state) const { mFunction(state); }
+
+private:
+    std::string mName;
+    std::function<void(BenchState&)> mFunction;
+    std::vector<int> mArgs;
+    int mMultiplier;
+};
+
+inline std::vector<BenchCase*>& BenchRegistry() {
+    static std::vector<BenchCase*> registry;
+    return registry;
+}
+
+inline BenchCase* RegisterBenchmark(const std::string& name, std::function<void(BenchState&)> fn) {
+    BenchCase* c = new BenchCase(name, fn);
+    BenchRegistry().push_back(c);
+    return c;
+}
+
+#define MICROBENCH_CONCAT2(a, b) a##b
+#define MICROBENCH_CONCAT(a, b) MICROBENCH_CONCAT2(a, b)
+
+#define BENCHMARK(fn) \
+    static BenchCase* MICROBENCH_CONCAT(microbench_, __LINE__) = RegisterBenchmark(#fn, fn)
+
+// BENCHMARK_CAPTURE(BM_Distortion, Tanh, DistTanh) registers "BM_Distortion/Tanh" calling fn(state, DistTanh)
+#define BENCHMARK_CAPTURE(fn, name, ...) \
+    static BenchCase* MICROBENCH_CONCAT(microbench_, __LINE__) = \
+        RegisterBenchmark(#fn "/" #name, [](BenchState& state) { fn(state, __VA_ARGS__); })
+
+// counter columns: cycles per item, instructions per cycle, the rest per 1000 items
+inline std::string FormatCounters(const PerfCounters& counters, const double items, const bool csv) {
+    std::string out;
+    char value[32];
+    for (int i = 0; i < PerfCounters::kNumCounters; i++) {
+        const bool available = counters.IsAvailable(i) && (i != PerfCounters::kInstructions || counters.IsAvailable(PerfCounters::kCycles));
+        double v = 0.;
+        if (i == PerfCounters::kCycles) v = counters.Total(i) / items;
+        else if (i == PerfCounters::kInstructions) v = counters.Total(PerfCounters::kCycles) > 0. ? counters.Total(i) / counters.Total(PerfCounters::kCycles) : 0.;
+        else v = 1000. * counters.Total(i) / items;
+        if (csv) snprintf(value, sizeof(value), available ? ",%.4f" : ",", v);
+        else if (available) snprintf(value, sizeof(value), " %10.3f", v);
+        else snprintf(value, sizeof(value), " %10s", "n/a");
+        out += value;
+    }
+    return out;
+}
+
+inline int RunBenchmarks(int argc, char** argv) {
+    std::string filter;
+    double minTime = 0.2;
+    bool csv = false, useCounters = false;
+    unsigned long long fpAssistEvent = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strncmp(argv[i], "--filter=", 9)) filter = argv[i] + 9;
+        else if (!strncmp(argv[i], "--min_time=", 11)) minTime = atof(argv[i] + 11);
+        else if (!strcmp(argv[i], "--csv")) csv = true;
+        else if (!strcmp(argv[i], "--counters")) useCounters = true;
+        else if (!strncmp(argv[i], "--fp_assist=", 12)) fpAssistEvent = strtoull(argv[i] + 12, 0, 16);
+        else {
+            fprintf(stderr, "usage: %s [--filter=<substring>] [--min_time=<seconds>] [--csv] [--counters] [--fp_assist=<hex>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    PerfCounters counters;
+    if (useCounters && !counters.Open(fpAssistEvent)) {
+        fprintf(stderr, "no hardware counters available (see /proc/sys/kernel/perf_event_paranoid), timing only\n");
+        useCounters = false;
+    }
+
+    if (csv) {
+        printf("name,arg,iterations,ns_per_iteration,ns_per_item");
+        if (useCounters) printf(",cycles_per_item,ipc,l1d_miss_per_kitem,llc_miss_per_kitem,branch_miss_per_kitem,fp_assist_per_kitem");
+        printf("\n");
+    }
+    else {
+        printf("%-40s %12s %14s %12s", "Benchmark", "Iterations", "ns/iteration", "ns/item");
+        if (useCounters) printf(" %10s %10s %10s %10s %10s %10s", "cyc/item", "IPC", "L1D/k", "LLC/k", "brmiss/k", "assist/k");
+        printf("\n");
+    }
+
+    const std::vector<BenchCase*>& cases = BenchRegistry();
+    for (size_t c = 0; c < cases.size(); c++) {
+        if (!filter.empty() && cases[c]->Name().find(filter) == std::string::npos) continue;
+        for (size_t a = 0; a < cases[c]->Args().size(); a++) {
+            const int arg = cases[c]->Args()[a];
+            long long iterations = 1;
+            for (;;) {
+                BenchState state(arg, iterations, useCounters ? &counters : 0);
+                cases[c]->Run(state);
+                if (state.Seconds() >= minTime || iterations >= (1LL << 40)) {
+                    const double nsPerIteration = 1e9 * state.Seconds() / (double)iterations;
+                    const double nsPerItem = state.ItemsProcessed() ? 1e9 * state.Seconds() / (double)state.ItemsProcessed() : 0.;
+                    // counters are per item, or per iteration for cases that count no items
+                    const double items = state.ItemsProcessed() ? (double)state.ItemsProcessed() : (double)iterations;
+                    const std::string counterColumns = useCounters ? FormatCounters(counters, items, csv) : std::string();
+                    if (csv) {
+                        printf("%s,%d,%lld,%.3f,%.4f%s\n", cases[c]->Name().c_str(), arg, iterations, nsPerIteration, nsPerItem, counterColumns.c_str());
+                    }
+                    else {
+                        char name[256];
+                        snprintf(name, sizeof(name), "%s/%d", cases[c]->Name().c_str(), arg);
+                        printf("%-40s %12lld %14.1f %12.3f%s\n", name, iterations, nsPerIteration, nsPerItem, counterColumns.c_str());
+                    }
+                    fflush(stdout);
+                    break;
+                }
+                // aim for the minimum time with some headroom, but never grow more than 10x at once
+                const double estimate = state.Seconds() > 0. ? 1.4 * minTime / state.Seconds() : 10.;
+                const double growth = estimate < 10. ? (estimate > 2. ? estimate : 2.) : 10.;
+                iterations = (long long)(iterations * growth);
+            }
+        }
+    }
+    return 0;
+}
+
+#endif /* microbench_h */
@@ -0,0 +1,205 @@
+//
+//  render_benchmark.cpp
+//  MultibandDistortion
+//
+//  End-to-end throughput of the full signal path (MultibandEngine) over minutes
+//  of synthetic program material with scripted automation. Every configuration
+//  (analyzer off/on x unlinked/linked x each mode on every band, plus cycling
+//  modes) renders the same material and reports:
+//    - realtime factor: audio duration / processing time
+//    - ns/sample: processing time per sample per channel
+//    - worst block: the slowest single block, also as % of the block's duration
+//
+//  With the analyzer on, every tap is written to the ring and a reader thread
+//  drains it continuously, as the editor would. --float runs the same matrix
+//  through the float engine (MultibandEngineFloat).
+//
+//  Command line:
+//    --seconds=<n>      length of the material (default 180)
+//    --block=<n>        block size (default 512)
+//    --rate=<hz>        sample rate (default 44100)
+//    --filter=<text>    only run configurations whose name contains <text>
+//    --float            float samples instead of double
+//    --channels=<n>     channels, 1 to 16 (default 2)
+//    --workers=<n>      band processing on a pool of n workers (default 0: serial)
+//    --multirate        low bands decimated
+//    --oversampling=<n> every band's shaper at 1, 2, 4 or 8 times the rate,
+//                       or 0 for auto (default 1)
+//    --fast             the table driven waveshapers (WaveshaperTables.h)
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MultibandEngine.h"
+#include "ProgramMaterial.h"
+
+struct RenderConfig
+{
+  std::string name;
+  bool analyzer;
+  bool linked;
+  int mode;
+};
+
+struct RenderResult
+{
+  double seconds;
+  double worstBlock;
+};
+
+template <typename T>
+static RenderResult Render(const RenderConfig& config, double sampleRate, int blockSize, double duration, int nChannels, WorkerPool* pool, bool multirate, int oversampling, bool fast)
+{
+  MultibandEngineT<T> engine(sampleRate);
+  ProgramMaterial material(sampleRate);
+  AutomationScript automation(sampleRate, config.mode);
+  engine.SetLinked(config.linked);
+  engine.SetMultirate(multirate);
+  for (int j = 0; j < 4; j++) engine.SetOversampling(j, oversampling);
+  engine.SetFastShapers(fast);
+  if (pool) engine.SetWorkerPool(pool);
+
+  //the editor side: drains the ring as fast as it fills
+  Spect_TapRing ring(kNumTaps, 1 << 14);
+  std::atomic<bool> running(true);
+  std::thread reader;
+  if (config.analyzer) {
+    engine.SetTaps(&ring, (1u << kNumTaps) - 1);
+    reader = std::thread([&]() {
+      while (running.load()) {
+        ring.Discard();
+        std::this_thread::yield();
+      }
+    });
+  }
+
+  //the material is generated in double and converted outside the timed part
+  std::vector<double> material64[kMaxChannels];
+  std::vector<T> in[kMaxChannels], out[kMaxChannels];
+  double* generated[kMaxChannels];
+  T* inputs[kMaxChannels];
+  T* outputs[kMaxChannels];
+  for (int c=0; c<nChannels; c++) {
+    material64[c].resize(blockSize);
+    in[c].resize(blockSize);
+    out[c].resize(blockSize);
+    generated[c] = &material64[c][0];
+    inputs[c] = &in[c][0];
+    outputs[c] = &out[c][0];
+  }
+
+  RenderResult result;
+  result.seconds = 0;
+  result.worstBlock = 0;
+  const long long total = (long long)(duration * sampleRate);
+  double sink = 0;
+  for (long long pos = 0; pos < total; pos += blockSize) {
+    const int n = (int)std::min((long long)blockSize, total - pos);
+    material.Render(generated, nChannels, n);
+    for (int c=0; c<nChannels; c++) {
+      for (int s=0; s<n; s++) inputs[c][s] = (T)generated[c][s];
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    automation.Apply(engine, pos);
+    engine.ProcessBlock(inputs, outputs, nChannels, n);
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    result.seconds += elapsed;
+    if (elapsed > result.worstBlock) result.worstBlock = elapsed;
+    sink += outputs[0][n - 1];
+  }
+
+  running.store(false);
+  if (reader.joinable()) reader.join();
+  if (sink != sink) printf("(output contains NaN)\n");
+  return result;
+}
+
+int main(int argc, char** argv)
+{
+  double duration = 180.;
+  int blockSize = 512;
+  double sampleRate = 44100.;
+  std::string filter;
+  bool useFloat = false;
+  int nChannels = 2;
+  int workers = 0;
+  bool multirate = false;
+  int oversampling = 1;
+  bool fast = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strncmp(argv[i], "--seconds=", 10)) duration = atof(argv[i] + 10);
+    else if (!strncmp(argv[i], "--block=", 8)) blockSize = atoi(argv[i] + 8);
+    else if (!strncmp(argv[i], "--rate=", 7)) sampleRate = atof(argv[i] + 7);
+    else if (!strncmp(argv[i], "--filter=", 9)) filter = argv[i] + 9;
+    else if (!strcmp(argv[i], "--float")) useFloat = true;
+    else if (!strncmp(argv[i], "--channels=", 11)) nChannels = atoi(argv[i] + 11);
+    else if (!strncmp(argv[i], "--workers=", 10)) workers = atoi(argv[i] + 10);
+    else if (!strcmp(argv[i], "--multirate")) multirate = true;
+    else if (!strncmp(argv[i], "--oversampling=", 15)) oversampling = atoi(argv[i] + 15);
+    else if (!strcmp(argv[i], "--fast")) fast = true;
+    else {
+      fprintf(stderr, "usage: %s [--seconds=<n>] [--block=<n>] [--rate=<hz>] [--filter=<text>] [--float] [--channels=<n>] [--workers=<n>] [--multirate] [--oversampling=<n>] [--fast]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (duration <= 0. || blockSize <= 0 || sampleRate <= 0.) {
+    fprintf(stderr, "seconds, block and rate must be positive\n");
+    return 1;
+  }
+  if (nChannels < 1 || nChannels > kMaxChannels) {
+    fprintf(stderr, "channels must be 1 to %d\n", kMaxChannels);
+    return 1;
+  }
+  if (workers < 0) {
+    fprintf(stderr, "workers must not be negative\n");
+    return 1;
+  }
+  if (oversampling != 0 && oversampling != 1 && oversampling != 2 && oversampling != 4 && oversampling != 8) {
+    fprintf(stderr, "oversampling must be 0 (auto), 1, 2, 4 or 8\n");
+    return 1;
+  }
+  WorkerPool pool(workers);
+
+  static const char* modeNames[NumDistortionModes] = { "Excite", "Fat", "Sine", "Fold", "Tanh", "Soft", "Cheby" };
+  std::vector<RenderConfig> configs;
+  for (int analyzer = 0; analyzer < 2; analyzer++) {
+    for (int linked = 0; linked < 2; linked++) {
+      for (int mode = -1; mode < NumDistortionModes; mode++) {
+        RenderConfig c;
+        c.analyzer = analyzer != 0;
+        c.linked = linked != 0;
+        c.mode = mode;
+        c.name = std::string(analyzer ? "analyzer" : "no-analyzer") + "/" + (linked ? "linked" : "unlinked") + "/" + (mode < 0 ? "cycling" : modeNames[mode]);
+        configs.push_back(c);
+      }
+    }
+  }
+
+  printf("%.0f s of material at %.0f Hz, %d sample blocks, %d channel(s), %s, %d band worker(s)%s", duration, sampleRate, blockSize, nChannels,
+         useFloat ? "float" : "double", workers, multirate ? ", multirate" : "");
+  if (oversampling == 0) printf(", auto oversampling");
+  else if (oversampling > 1) printf(", %dx oversampling", oversampling);
+  if (fast) printf(", fast waveshapers");
+  printf("\n");
+  printf("%-32s %12s %12s %16s %14s\n", "Configuration", "Realtime", "ns/sample", "Worst block us", "Worst block %");
+  const double blockSeconds = blockSize / sampleRate;
+  for (size_t i = 0; i < configs.size(); i++) {
+    if (!filter.empty() && configs[i].name.find(filter) == std::string::npos) continue;
+    const RenderResult r = useFloat ? Render<float>(configs[i], sampleRate, blockSize, duration, nChannels, workers ? &pool : 0, multirate, oversampling, fast)
+                                    : Render<double>(configs[i], sampleRate, blockSize, duration, nChannels, workers ? &pool : 0, multirate, oversampling, fast);
+    const double samples = duration * sampleRate * nChannels;
+    printf("%-32s %11.1fx %12.2f %16.1f %13.2f%%\n", configs[i].name.c_str(), duration / r.seconds, 1e9 * r.seconds / samples,
+           1e6 * r.worstBlock, 100. * r.worstBlock / blockSeconds);
+    fflush(stdout);
+  }
+  return 0;
+}
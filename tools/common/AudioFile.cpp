@@ -0,0 +1,358 @@
+//
+//  AudioFile.cpp
+//  MultibandDistortion
+//
+
+#include "AudioFile.h"
+
+#include <cmath>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static unsigned int ReadLE32(const unsigned char* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24); }
+static unsigned int ReadLE16(const unsigned char* p) { return p[0] | (p[1] << 8); }
+static unsigned int ReadBE32(const unsigned char* p) { return ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+static unsigned int ReadBE16(const unsigned char* p) { return (p[0] << 8) | p[1]; }
+
+// the 80 bit IEEE extended AIFF stores its sample rate in
+static double ReadExtended(const unsigned char* p)
+{
+  const int exponent = ((p[0] & 0x7F) << 8) | p[1];
+  unsigned long long mantissa = 0;
+  for (int i = 0; i < 8; i++) mantissa = (mantissa << 8) | p[2 + i];
+  if (!exponent && !mantissa) return 0.;
+  const double value = ldexp((double)mantissa, exponent - 16383 - 63);
+  return (p[0] & 0x80) ? -value : value;
+}
+
+AudioFileReader::AudioFileReader()
+: mData(0), mSize(0), mMapping(0), mSamples(0), mNumChannels(0), mBytesPerSample(0), mEncoding(PCMLittle),
+  mSampleRate(0.), mNumFrames(0), mPosition(0)
+{
+}
+
+AudioFileReader::~AudioFileReader()
+{
+  Close();
+}
+
+bool AudioFileReader::Open(const std::string& path, std::string& error)
+{
+  Close();
+
+#ifndef _WIN32
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error = "can not open " + path;
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    void* p = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      //read front to back, once
+      madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+      mMapping = p;
+      mData = (const unsigned char*)p;
+      mSize = (size_t)st.st_size;
+    }
+  }
+  close(fd);
+#endif
+
+  if (!mData) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+      error = "can not open " + path;
+      return false;
+    }
+    unsigned char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) mBuffer.insert(mBuffer.end(), chunk, chunk + n);
+    fclose(f);
+    mData = mBuffer.empty() ? 0 : &mBuffer[0];
+    mSize = mBuffer.size();
+  }
+
+  bool ok = false;
+  if (mSize >= 12 && !memcmp(mData, "RIFF", 4) && !memcmp(mData + 8, "WAVE", 4)) ok = ParseWav(error);
+  else if (mSize >= 12 && !memcmp(mData, "FORM", 4) && (!memcmp(mData + 8, "AIFF", 4) || !memcmp(mData + 8, "AIFC", 4))) ok = ParseAiff(error);
+  else error = "not a WAV or AIFF file";
+
+  if (!ok) {
+    error = path + ": " + error;
+    Close();
+  }
+  return ok;
+}
+
+void AudioFileReader::Close()
+{
+#ifndef _WIN32
+  if (mMapping) munmap(mMapping, mSize);
+#endif
+  mMapping = 0;
+  mBuffer.clear();
+  mData = 0;
+  mSize = 0;
+  mSamples = 0;
+  mNumChannels = 0;
+  mNumFrames = 0;
+  mPosition = 0;
+}
+
+bool AudioFileReader::ParseWav(std::string& error)
+{
+  int format = -1, bits = 0;
+  const unsigned char* data = 0;
+  size_t dataSize = 0;
+
+  size_t pos = 12;
+  while (pos + 8 <= mSize) {
+    const unsigned char* chunk = mData + pos;
+    const size_t size = ReadLE32(chunk + 4);
+    const size_t available = mSize - pos - 8 < size ? mSize - pos - 8 : size;
+    if (!memcmp(chunk, "fmt ", 4) && available >= 16) {
+      format = ReadLE16(chunk + 8);
+      mNumChannels = ReadLE16(chunk + 10);
+      mSampleRate = ReadLE32(chunk + 12);
+      bits = ReadLE16(chunk + 22);
+      //WAVE_FORMAT_EXTENSIBLE: the real format leads the sub format GUID
+      if (format == 0xFFFE && available >= 26) format = ReadLE16(chunk + 32);
+    }
+    else if (!memcmp(chunk, "data", 4)) {
+      data = chunk + 8;
+      dataSize = available;
+    }
+    pos += 8 + size + (size & 1);
+  }
+
+  if (format < 0 || !data) {
+    error = "fmt or data chunk missing";
+    return false;
+  }
+  if (format == 1 && (bits == 8 || bits == 16 || bits == 24 || bits == 32)) mEncoding = PCMLittle;
+  else if (format == 3 && (bits == 32 || bits == 64)) mEncoding = FloatLittle;
+  else {
+    error = "unsupported WAV encoding";
+    return false;
+  }
+  if (mNumChannels <= 0 || mSampleRate <= 0.) {
+    error = "invalid channel count or sample rate";
+    return false;
+  }
+  mBytesPerSample = bits / 8;
+  mSamples = data;
+  mNumFrames = (long long)(dataSize / (mBytesPerSample * mNumChannels));
+  return true;
+}
+
+bool AudioFileReader::ParseAiff(std::string& error)
+{
+  const bool aifc = !memcmp(mData + 8, "AIFC", 4);
+  int bits = 0;
+  bool haveComm = false;
+  char compression[4] = { 'N', 'O', 'N', 'E' };
+  const unsigned char* data = 0;
+  size_t dataSize = 0;
+
+  size_t pos = 12;
+  while (pos + 8 <= mSize) {
+    const unsigned char* chunk = mData + pos;
+    const size_t size = ReadBE32(chunk + 4);
+    const size_t available = mSize - pos - 8 < size ? mSize - pos - 8 : size;
+    if (!memcmp(chunk, "COMM", 4) && available >= 18) {
+      mNumChannels = ReadBE16(chunk + 8);
+      bits = ReadBE16(chunk + 14);
+      mSampleRate = ReadExtended(chunk + 16);
+      if (aifc && available >= 22) memcpy(compression, chunk + 26, 4);
+      haveComm = true;
+    }
+    else if (!memcmp(chunk, "SSND", 4) && available >= 8) {
+      const size_t offset = ReadBE32(chunk + 8);
+      if (offset <= available - 8) {
+        data = chunk + 16 + offset;
+        dataSize = available - 8 - offset;
+      }
+    }
+    pos += 8 + size + (size & 1);
+  }
+
+  if (!haveComm || !data) {
+    error = "COMM or SSND chunk missing";
+    return false;
+  }
+  if (!memcmp(compression, "NONE", 4) && (bits == 8 || bits == 16 || bits == 24 || bits == 32)) mEncoding = PCMBig;
+  else if (!memcmp(compression, "sowt", 4) && (bits == 16 || bits == 24 || bits == 32)) mEncoding = PCMLittle;
+  else if (!memcmp(compression, "fl32", 4) || !memcmp(compression, "FL32", 4)) { mEncoding = FloatBig; bits = 32; }
+  else if (!memcmp(compression, "fl64", 4) || !memcmp(compression, "FL64", 4)) { mEncoding = FloatBig; bits = 64; }
+  else {
+    error = "unsupported AIFF encoding";
+    return false;
+  }
+  if (mNumChannels <= 0 || mSampleRate <= 0.) {
+    error = "invalid channel count or sample rate";
+    return false;
+  }
+  mBytesPerSample = bits / 8;
+  mSamples = data;
+  mNumFrames = (long long)(dataSize / (mBytesPerSample * mNumChannels));
+  return true;
+}
+
+int AudioFileReader::Read(double** outputs, int nFrames)
+{
+  if (nFrames > mNumFrames - mPosition) nFrames = (int)(mNumFrames - mPosition);
+  if (nFrames <= 0) return 0;
+  ReadAt(mPosition, outputs, nFrames);
+  mPosition += nFrames;
+  return nFrames;
+}
+
+void AudioFileReader::ReadAt(long long frame, double** outputs, int nFrames) const
+{
+  const int bytes = mBytesPerSample;
+  const unsigned char* p = mSamples + frame * bytes * mNumChannels;
+  //8 bit WAV is unsigned, 8 bit AIFF signed
+  const bool unsigned8 = bytes == 1 && mEncoding == PCMLittle;
+
+  for (int s = 0; s < nFrames; s++) {
+    for (int c = 0; c < mNumChannels; c++, p += bytes) {
+      double v;
+      if (mEncoding == PCMLittle || mEncoding == PCMBig) {
+        //the sample's bytes into the top of a 32 bit word
+        unsigned int word = 0;
+        for (int b = 0; b < bytes; b++) {
+          const unsigned int byte = mEncoding == PCMLittle ? p[bytes - 1 - b] : p[b];
+          word |= byte << (24 - 8 * b);
+        }
+        if (unsigned8) word ^= 0x80000000u;
+        v = (double)(int)word / 2147483648.;
+      }
+      else {
+        unsigned char swapped[8];
+        for (int b = 0; b < bytes; b++) swapped[b] = mEncoding == FloatLittle ? p[b] : p[bytes - 1 - b];
+        if (bytes == 4) {
+          float f;
+          memcpy(&f, swapped, 4);
+          v = f;
+        }
+        else memcpy(&v, swapped, 8);
+      }
+      outputs[c][s] = v;
+    }
+  }
+}
+
+AudioFileWriter::AudioFileWriter()
+: mFile(0), mNumChannels(0), mFormat(Float32), mDataBytes(0), mFailed(false)
+{
+}
+
+AudioFileWriter::~AudioFileWriter()
+{
+  if (mFile) Close();
+}
+
+static void PutLE16(unsigned char* p, unsigned int v) { p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF; }
+static void PutLE32(unsigned char* p, unsigned int v) { PutLE16(p, v & 0xFFFF); PutLE16(p + 2, v >> 16); }
+
+static int BytesPerSample(AudioFileWriter::Format format)
+{
+  return format == AudioFileWriter::PCM16 ? 2 : format == AudioFileWriter::PCM24 ? 3 : 4;
+}
+
+bool AudioFileWriter::Open(const std::string& path, int numChannels, double sampleRate, Format format, std::string& error)
+{
+  mFile = fopen(path.c_str(), "wb");
+  if (!mFile) {
+    error = "can not create " + path;
+    return false;
+  }
+  mNumChannels = numChannels;
+  mFormat = format;
+  mDataBytes = 0;
+  mFailed = false;
+
+  //sizes are filled in by Close()
+  const int bytes = BytesPerSample(format);
+  unsigned char header[44];
+  memcpy(header, "RIFF", 4);
+  PutLE32(header + 4, 0);
+  memcpy(header + 8, "WAVEfmt ", 8);
+  PutLE32(header + 16, 16);
+  PutLE16(header + 20, format == Float32 ? 3 : 1);
+  PutLE16(header + 22, numChannels);
+  PutLE32(header + 24, (unsigned int)sampleRate);
+  PutLE32(header + 28, (unsigned int)sampleRate * numChannels * bytes);
+  PutLE16(header + 32, numChannels * bytes);
+  PutLE16(header + 34, bytes * 8);
+  memcpy(header + 36, "data", 4);
+  PutLE32(header + 40, 0);
+  if (fwrite(header, 1, sizeof(header), mFile) != sizeof(header)) {
+    error = "can not write " + path;
+    fclose(mFile);
+    mFile = 0;
+    return false;
+  }
+  return true;
+}
+
+bool AudioFileWriter::Write(double** inputs, int nFrames)
+{
+  if (!mFile) return false;
+  const int bytes = BytesPerSample(mFormat);
+  mBuffer.resize((size_t)nFrames * mNumChannels * bytes);
+  //nothing to write, and no buffer to write it from
+  if (mBuffer.empty()) return !mFailed;
+  unsigned char* p = &mBuffer[0];
+
+  for (int s = 0; s < nFrames; s++) {
+    for (int c = 0; c < mNumChannels; c++, p += bytes) {
+      const double v = inputs[c][s];
+      if (mFormat == Float32) {
+        const float f = (float)v;
+        unsigned int word;
+        memcpy(&word, &f, 4);
+        PutLE32(p, word);
+      }
+      else {
+        const double scale = mFormat == PCM16 ? 32768. : 8388608.;
+        double x = floor(v * scale + 0.5);
+        if (x > scale - 1.) x = scale - 1.;
+        if (x < -scale) x = -scale;
+        const int i = (int)x;
+        p[0] = i & 0xFF;
+        p[1] = (i >> 8) & 0xFF;
+        if (bytes == 3) p[2] = (i >> 16) & 0xFF;
+      }
+    }
+  }
+
+  if (fwrite(&mBuffer[0], 1, mBuffer.size(), mFile) != mBuffer.size()) mFailed = true;
+  mDataBytes += mBuffer.size();
+  return !mFailed;
+}
+
+bool AudioFileWriter::Close()
+{
+  if (!mFile) return false;
+  bool ok = !mFailed && mDataBytes <= 0xFFFFFFFFLL - 36;
+  if (mDataBytes & 1) ok = ok && fputc(0, mFile) != EOF;
+
+  unsigned char size[4];
+  PutLE32(size, (unsigned int)(36 + mDataBytes + (mDataBytes & 1)));
+  ok = ok && fseek(mFile, 4, SEEK_SET) == 0 && fwrite(size, 1, 4, mFile) == 4;
+  PutLE32(size, (unsigned int)mDataBytes);
+  ok = ok && fseek(mFile, 40, SEEK_SET) == 0 && fwrite(size, 1, 4, mFile) == 4;
+
+  ok = fclose(mFile) == 0 && ok;
+  mFile = 0;
+  return ok;
+}
@@ -0,0 +1,87 @@
+//
+//  AudioFile.h
+//  MultibandDistortion
+//
+//  Streaming audio file I/O for the command line tools.
+//
+//  AudioFileReader maps the whole file into memory and decodes it chunk by chunk
+//  into deinterleaved doubles. It reads WAV (PCM 8/16/24/32 bit, 32/64 bit float,
+//  WAVE_FORMAT_EXTENSIBLE) and AIFF/AIFF-C (PCM 8/16/24/32 bit, little endian
+//  'sowt', 32/64 bit float).
+//
+//  AudioFileWriter writes WAV, 16 or 24 bit PCM or 32 bit float, and fills in
+//  the sizes on Close().
+//
+
+#ifndef AudioFile_h
+#define AudioFile_h
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class AudioFileReader
+{
+public:
+  AudioFileReader();
+  ~AudioFileReader();
+
+  // false with a message in error if the file can not be read
+  bool Open(const std::string& path, std::string& error);
+  void Close();
+
+  int GetNumChannels() const { return mNumChannels; }
+  double GetSampleRate() const { return mSampleRate; }
+  long long GetNumFrames() const { return mNumFrames; }
+
+  // decodes up to nFrames frames from the current position into outputs[channel],
+  // returns the number of frames read, 0 at the end
+  int Read(double** outputs, int nFrames);
+
+  // decodes nFrames frames starting at frame into outputs[channel], without moving the position
+  void ReadAt(long long frame, double** outputs, int nFrames) const;
+
+private:
+  enum Encoding { PCMLittle, PCMBig, FloatLittle, FloatBig };
+
+  bool ParseWav(std::string& error);
+  bool ParseAiff(std::string& error);
+
+  const unsigned char* mData;
+  size_t mSize;
+  void* mMapping;
+  std::vector<unsigned char> mBuffer; // when the file can not be mapped
+
+  const unsigned char* mSamples;
+  int mNumChannels, mBytesPerSample;
+  Encoding mEncoding;
+  double mSampleRate;
+  long long mNumFrames, mPosition;
+};
+
+class AudioFileWriter
+{
+public:
+  enum Format { PCM16 = 0, PCM24, Float32 };
+
+  AudioFileWriter();
+  ~AudioFileWriter();
+
+  bool Open(const std::string& path, int numChannels, double sampleRate, Format format, std::string& error);
+
+  // writes nFrames frames from inputs[channel]; PCM is clipped to full scale
+  bool Write(double** inputs, int nFrames);
+
+  // completes the header and closes the file, false if anything could not be written
+  bool Close();
+
+private:
+  FILE* mFile;
+  int mNumChannels;
+  Format mFormat;
+  long long mDataBytes;
+  bool mFailed;
+  std::vector<unsigned char> mBuffer;
+};
+
+#endif /* AudioFile_h */
@@ -0,0 +1,139 @@
+//
+//  Loudness.h
+//  MultibandDistortion
+//
+//  Level statistics for rendered files: sample peak, RMS and integrated
+//  loudness after ITU-R BS.1770-4 (K-weighting, 400 ms blocks with 75% overlap,
+//  -70 LUFS absolute and -10 LU relative gate). Any number of channels, all
+//  weighted 1: the files carry no layout to tell surrounds and LFE apart.
+//
+
+#ifndef Loudness_h
+#define Loudness_h
+
+#define _USE_MATH_DEFINES		// to use M_PI
+#include <cmath>
+#include <vector>
+
+class LoudnessMeter
+{
+public:
+  LoudnessMeter(double sampleRate, int numChannels)
+  : mNumChannels(numChannels), mPeak(0.), mSquares(0.), mSamples(0), mSubBlockFill(0), mSubBlocks(0)
+  {
+    //pre filter: high shelf, +4 dB above ~1.7 kHz
+    {
+      const double f0 = 1681.974450955533, G = 3.999843853973347, Q = 0.7071752369554196;
+      const double K = tan(M_PI * f0 / sampleRate);
+      const double Vh = pow(10., G / 20.), Vb = pow(Vh, 0.4996667741545416);
+      const double a0 = 1. + K / Q + K * K;
+      mShelf.Set((Vh + Vb * K / Q + K * K) / a0, 2. * (K * K - Vh) / a0, (Vh - Vb * K / Q + K * K) / a0,
+                 2. * (K * K - 1.) / a0, (1. - K / Q + K * K) / a0);
+    }
+    //RLB weighting: high pass at ~38 Hz
+    {
+      const double f0 = 38.13547087602444, Q = 0.5003270373238773;
+      const double K = tan(M_PI * f0 / sampleRate);
+      const double a0 = 1. + K / Q + K * K;
+      mHighpass.Set(1., -2., 1., 2. * (K * K - 1.) / a0, (1. - K / Q + K * K) / a0);
+    }
+    mShelfState.assign(2 * numChannels, 0.);
+    mHighpassState.assign(2 * numChannels, 0.);
+    mSubBlockLength = (int)(0.1 * sampleRate + 0.5);
+    for (int i = 0; i < 4; i++) mSubBlockEnergy[i] = 0.;
+    mCurrentEnergy = 0.;
+  }
+
+  void Process(double** inputs, int nFrames)
+  {
+    for (int s = 0; s < nFrames; s++) {
+      double weighted = 0.;
+      for (int c = 0; c < mNumChannels; c++) {
+        const double x = inputs[c][s];
+        const double a = fabs(x);
+        if (a > mPeak) mPeak = a;
+        mSquares += x * x;
+        const double y = mHighpass.Process(mShelf.Process(x, &mShelfState[2 * c]), &mHighpassState[2 * c]);
+        weighted += y * y;
+      }
+      mSamples++;
+      mCurrentEnergy += weighted;
+      if (++mSubBlockFill == mSubBlockLength) EndSubBlock();
+    }
+  }
+
+  double GetPeakDB() const { return ToDB(mPeak); }
+
+  double GetRMSDB() const { return mSamples ? 10. * log10(mSquares / ((double)mSamples * mNumChannels) + 1e-30) : -300.; }
+
+  // integrated loudness in LUFS, -300 when everything is gated away
+  double GetIntegratedLUFS() const
+  {
+    const double absoluteGate = AbsoluteGate();
+    double sum = 0.;
+    int n = 0;
+    for (size_t i = 0; i < mBlocks.size(); i++) {
+      if (mBlocks[i] > absoluteGate) {
+        sum += mBlocks[i];
+        n++;
+      }
+    }
+    if (!n) return -300.;
+    const double relativeGate = BlockLoudness(sum / n) - 10.;
+    sum = 0.;
+    n = 0;
+    for (size_t i = 0; i < mBlocks.size(); i++) {
+      if (mBlocks[i] > absoluteGate && BlockLoudness(mBlocks[i]) > relativeGate) {
+        sum += mBlocks[i];
+        n++;
+      }
+    }
+    return n ? BlockLoudness(sum / n) : -300.;
+  }
+
+private:
+  struct Biquad
+  {
+    void Set(double pb0, double pb1, double pb2, double pa1, double pa2) { b0 = pb0; b1 = pb1; b2 = pb2; a1 = pa1; a2 = pa2; }
+
+    // transposed direct form II
+    double Process(double x, double* z) const
+    {
+      const double y = b0 * x + z[0];
+      z[0] = b1 * x - a1 * y + z[1];
+      z[1] = b2 * x - a2 * y;
+      return y;
+    }
+
+    double b0, b1, b2, a1, a2;
+  };
+
+  static double ToDB(double x) { return 20. * log10(x + 1e-30); }
+  static double BlockLoudness(double meanSquare) { return -0.691 + 10. * log10(meanSquare + 1e-30); }
+
+  // a block's mean square energy at the absolute gate of -70 LUFS
+  static double AbsoluteGate() { return pow(10., (-70. + 0.691) / 10.); }
+
+  void EndSubBlock()
+  {
+    mSubBlockEnergy[mSubBlocks % 4] = mCurrentEnergy;
+    mCurrentEnergy = 0.;
+    mSubBlockFill = 0;
+    if (++mSubBlocks >= 4) {
+      const double energy = mSubBlockEnergy[0] + mSubBlockEnergy[1] + mSubBlockEnergy[2] + mSubBlockEnergy[3];
+      mBlocks.push_back(energy / (4. * mSubBlockLength));
+    }
+  }
+
+  int mNumChannels;
+  Biquad mShelf, mHighpass;
+  std::vector<double> mShelfState, mHighpassState; // 2 per channel
+  double mPeak, mSquares;
+  long long mSamples;
+  int mSubBlockLength, mSubBlockFill;
+  long long mSubBlocks;
+  double mSubBlockEnergy[4], mCurrentEnergy;
+  std::vector<double> mBlocks;
+};
+
+#endif /* Loudness_h */
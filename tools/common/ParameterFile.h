@@ -0,0 +1,270 @@
+//
+//  ParameterFile.h
+//  MultibandDistortion
+//
+//  Plugin settings for the command line tools, by the plugin's parameter names.
+//  A parameter file has one "<name> = <value>" per line, # starts a comment:
+//
+//    Input Gain = 3
+//    Band 2: Drive = 18          # dB
+//    Band 2: Mix = 75            # %
+//    Band 2: Mode = Tanh         # or 0..6
+//    Band 4: Mute = on
+//    Band 4: Oversampling = 4x   # Auto, 1x, 2x, 4x or 8x
+//    Crossover 1: Freq = 150     # Hz
+//    Link Distortion Modes = off
+//    Waveshapers = Fast          # or Exact
+//
+//  Units are the ones the plugin shows, except the crossovers, which are given
+//  in Hz rather than as the knob position. Output Gain is accepted but, as in the
+//  plugin, has no effect on the signal; the analyzer settings are ignored.
+//  Anything not set keeps the plugin's default.
+//
+
+#ifndef ParameterFile_h
+#define ParameterFile_h
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "MultibandEngine.h"
+#include "Distortion.h"
+
+class ParameterFile
+{
+public:
+  ParameterFile()
+  {
+    inputGain = 0.;
+    outputGain = 0.;
+    outputClipping = false;
+    linked = false;
+    fastShapers = false;
+    for (int j=0; j<4; j++) {
+      drive[j] = -3.;
+      mix[j] = 100.;
+      mode[j] = DistExcite;
+      enable[j] = true;
+      solo[j] = false;
+      mute[j] = false;
+      oversampling[j] = 1;
+    }
+    //the plugin's default knob positions
+    for (int i=0; i<3; i++) crossover[i] = 20. * pow(1000., 0.25 * (i + 1));
+  }
+
+  static const char* ModeName(int m)
+  {
+    static const char* names[NumDistortionModes] = { "Excite", "Fat", "Sine", "Fold", "Tanh", "Soft", "Cheby" };
+    return names[m];
+  }
+
+  // one "name = value" assignment
+  bool Parse(const std::string& assignment, std::string& error)
+  {
+    const size_t eq = assignment.find('=');
+    if (eq == std::string::npos) {
+      error = "expected <name> = <value>: " + assignment;
+      return false;
+    }
+    return Set(Trim(assignment.substr(0, eq)), Trim(assignment.substr(eq + 1)), error);
+  }
+
+  bool Load(const std::string& path, std::string& error)
+  {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) {
+      error = "can not open " + path;
+      return false;
+    }
+    char line[1024];
+    int number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+      number++;
+      std::string text = line;
+      const size_t comment = text.find('#');
+      if (comment != std::string::npos) text.erase(comment);
+      if (Trim(text).empty()) continue;
+      if (!Parse(text, error)) {
+        char where[32];
+        snprintf(where, sizeof(where), ":%d: ", number);
+        error = path + where + error;
+        ok = false;
+      }
+    }
+    fclose(f);
+    return ok;
+  }
+
+  bool Set(const std::string& name, const std::string& value, std::string& error)
+  {
+    const std::string key = Lower(name);
+    int band = -1;
+    std::string field = key;
+    if (key.size() > 8 && (key.compare(0, 5, "band ") == 0 || key.compare(0, 10, "crossover ") == 0)) {
+      const size_t colon = key.find(':');
+      if (colon != std::string::npos) {
+        band = atoi(key.c_str() + key.find(' ') + 1) - 1;
+        field = key.substr(0, key.find(' ')) + Trim(key.substr(colon + 1));
+      }
+    }
+
+    bool ok = true;
+    if (field == "input gain") ok = Number(value, -36., 36., inputGain, error);
+    else if (field == "output gain") ok = Number(value, -36., 36., outputGain, error);
+    else if (field == "output clipping") ok = Bool(value, outputClipping, error);
+    else if (field == "link distortion modes") ok = Bool(value, linked, error);
+    else if (field == "waveshapers") ok = Shapers(value, fastShapers, error);
+    else if (field.compare(0, 9, "analyzer ") == 0) {}
+    else if (field.compare(0, 4, "band") == 0 && band >= 0 && band < 4) {
+      const std::string what = field.substr(4);
+      if (what == "drive") ok = Number(value, -3., 36., drive[band], error);
+      else if (what == "mix") ok = Number(value, 0., 100., mix[band], error);
+      else if (what == "mode") ok = Mode(value, mode[band], error);
+      else if (what == "enable") ok = Bool(value, enable[band], error);
+      else if (what == "solo") ok = Bool(value, solo[band], error);
+      else if (what == "mute") ok = Bool(value, mute[band], error);
+      else if (what == "oversampling") ok = Oversampling(value, oversampling[band], error);
+      else ok = Unknown(name, error);
+    }
+    else if (field == "crossoverfreq" && band >= 0 && band < 3) ok = Number(value, 20., 20000., crossover[band], error);
+    else ok = Unknown(name, error);
+
+    if (!ok && error.find(name) == std::string::npos) error = name + ": " + error;
+    return ok;
+  }
+
+  template <typename T>
+  void Apply(MultibandEngineT<T>& engine) const
+  {
+    engine.SetInputGain(inputGain);
+    engine.SetOutputClipping(outputClipping);
+    engine.SetLinked(linked);
+    engine.SetFastShapers(fastShapers);
+    for (int j=0; j<4; j++) {
+      engine.SetDrive(j, drive[j]);
+      engine.SetMix(j, mix[j] / 100.);
+      engine.SetMode(j, mode[j]);
+      engine.SetEnable(j, enable[j]);
+      engine.SetSolo(j, solo[j]);
+      engine.SetMute(j, mute[j]);
+      engine.SetOversampling(j, oversampling[j]);
+    }
+    for (int i=0; i<3; i++) engine.SetCrossover(i, crossover[i]);
+  }
+
+  double inputGain, outputGain;
+  bool outputClipping, linked, fastShapers;
+  double drive[4], mix[4];
+  int mode[4];
+  bool enable[4], solo[4], mute[4];
+  int oversampling[4]; //0 for auto
+  double crossover[3];
+
+private:
+  static std::string Trim(const std::string& s)
+  {
+    size_t b = 0, e = s.size();
+    while (b < e && isspace((unsigned char)s[b])) b++;
+    while (e > b && isspace((unsigned char)s[e - 1])) e--;
+    return s.substr(b, e - b);
+  }
+
+  static std::string Lower(const std::string& s)
+  {
+    std::string out = s;
+    for (size_t i = 0; i < out.size(); i++) out[i] = (char)tolower((unsigned char)out[i]);
+    return out;
+  }
+
+  static bool Unknown(const std::string& name, std::string& error)
+  {
+    error = "unknown parameter " + name;
+    return false;
+  }
+
+  static bool Number(const std::string& value, double lo, double hi, double& out, std::string& error)
+  {
+    char* end = 0;
+    const double v = strtod(value.c_str(), &end);
+    if (end == value.c_str() || !Trim(end).empty()) {
+      error = "not a number: " + value;
+      return false;
+    }
+    if (v < lo || v > hi) {
+      char range[64];
+      snprintf(range, sizeof(range), " is outside %g..%g", lo, hi);
+      error = value + range;
+      return false;
+    }
+    out = v;
+    return true;
+  }
+
+  static bool Bool(const std::string& value, bool& out, std::string& error)
+  {
+    const std::string v = Lower(value);
+    if (v == "on" || v == "true" || v == "1" || v == "yes") out = true;
+    else if (v == "off" || v == "false" || v == "0" || v == "no") out = false;
+    else {
+      error = "expected on or off: " + value;
+      return false;
+    }
+    return true;
+  }
+
+  static bool Mode(const std::string& value, int& out, std::string& error)
+  {
+    for (int m = 0; m < NumDistortionModes; m++) {
+      if (Lower(value) == Lower(ModeName(m))) {
+        out = m;
+        return true;
+      }
+    }
+    char* end = 0;
+    const long m = strtol(value.c_str(), &end, 10);
+    if (end != value.c_str() && Trim(end).empty() && m >= 0 && m < NumDistortionModes) {
+      out = (int)m;
+      return true;
+    }
+    error = "unknown mode " + value;
+    return false;
+  }
+
+  static bool Shapers(const std::string& value, bool& fast, std::string& error)
+  {
+    const std::string v = Lower(value);
+    if (v == "exact") fast = false;
+    else if (v == "fast") fast = true;
+    else {
+      error = "expected Exact or Fast: " + value;
+      return false;
+    }
+    return true;
+  }
+
+  static bool Oversampling(const std::string& value, int& out, std::string& error)
+  {
+    const std::string v = Lower(value);
+    if (v == "auto") {
+      out = 0;
+      return true;
+    }
+    for (int factor = 1; factor <= 8; factor *= 2) {
+      char name[8];
+      snprintf(name, sizeof(name), "%d", factor);
+      if (v == name || v == std::string(name) + "x") {
+        out = factor;
+        return true;
+      }
+    }
+    error = "expected Auto, 1x, 2x, 4x or 8x: " + value;
+    return false;
+  }
+};
+
+#endif /* ParameterFile_h */
@@ -0,0 +1,221 @@
+//
+//  ProgramMaterial.h
+//  MultibandDistortion
+//
+//  Deterministic synthetic program material and parameter automation for the
+//  command line tools. Everything is generated block by block from a seed, so
+//  runs of any length need no audio files and repeat exactly.
+//
+
+#ifndef ProgramMaterial_h
+#define ProgramMaterial_h
+
+#define _USE_MATH_DEFINES		// to use M_PI
+#include <cmath>
+
+#include "MultibandEngine.h"
+#include "Distortion.h"
+
+// Test signal for up to kMaxChannels channels, cycling through sections of pink
+// noise, drum-like transients, a logarithmic sine sweep and all three mixed.
+class ProgramMaterial
+{
+public:
+  enum Section { SectionPink = 0, SectionDrums, SectionSweep, SectionMix, NumSections };
+
+  ProgramMaterial(double sampleRate, double sectionSeconds = 15.)
+  : mSampleRate(sampleRate), mSectionLength((long long)(sectionSeconds * sampleRate)), mPosition(0), mSeed(0x2545F491)
+  {
+    for (int c=0; c<kMaxChannels; c++) {
+      for (int i=0; i<7; i++) mPink[c][i] = 0;
+    }
+    mSweepPhase = 0;
+    mKickPhase = 0;
+  }
+
+  // fills nFrames samples of up to kMaxChannels channels; the pink noise is
+  // independent per channel, the rest is the same on all of them
+  void Render(double** outputs, int nChannels, int nFrames)
+  {
+    for (int s=0; s<nFrames; s++, mPosition++) {
+      const int section = (int)((mPosition / mSectionLength) % NumSections);
+      const double t = (double)mPosition / mSampleRate;
+      const double drums = (section == SectionDrums || section == SectionMix) ? Drums(t) : 0.;
+      const double sweep = (section == SectionSweep || section == SectionMix) ? Sweep(t) : 0.;
+      for (int c=0; c<nChannels; c++) {
+        const double pink = (section == SectionPink || section == SectionMix) ? Pink(c) : 0.;
+        outputs[c][s] = 0.5 * pink + 0.8 * drums + 0.4 * sweep;
+      }
+    }
+  }
+
+private:
+  // uniform in [-1, 1)
+  double White()
+  {
+    mSeed ^= mSeed << 13;
+    mSeed ^= mSeed >> 17;
+    mSeed ^= mSeed << 5;
+    return (double)mSeed / 2147483648. - 1.;
+  }
+
+  // Paul Kellet's refined pink noise filter
+  double Pink(int c)
+  {
+    double* b = mPink[c];
+    const double white = White();
+    b[0] = 0.99886 * b[0] + white * 0.0555179;
+    b[1] = 0.99332 * b[1] + white * 0.0750759;
+    b[2] = 0.96900 * b[2] + white * 0.1538520;
+    b[3] = 0.86650 * b[3] + white * 0.3104856;
+    b[4] = 0.55000 * b[4] + white * 0.5329522;
+    b[5] = -0.7616 * b[5] - white * 0.0168980;
+    const double pink = b[0] + b[1] + b[2] + b[3] + b[4] + b[5] + b[6] + white * 0.5362;
+    b[6] = white * 0.115926;
+    return pink * 0.11;
+  }
+
+  // 120 bpm eighths: kick on the beat, snare on 2 and 4, hats in between
+  double Drums(double t)
+  {
+    const double step = 0.25;
+    const int n = (int)(t / step);
+    const double local = t - n * step;
+    if (n % 2 == 0 && n % 4 != 2) {
+      // kick: sine dropping from 150 to 50 Hz
+      const double f = 50. + 100. * exp(-local * 30.);
+      mKickPhase += 2. * M_PI * f / mSampleRate;
+      return sin(mKickPhase) * exp(-local * 12.);
+    }
+    mKickPhase = 0;
+    if (n % 4 == 2) {
+      // snare: noise burst
+      return White() * exp(-local * 25.);
+    }
+    // hat: very short noise
+    return 0.3 * White() * exp(-local * 120.);
+  }
+
+  // 20 Hz to 20 kHz in 10 seconds
+  double Sweep(double t)
+  {
+    const double period = 10.;
+    const double local = fmod(t, period);
+    const double f = 20. * pow(1000., local / period);
+    mSweepPhase += 2. * M_PI * f / mSampleRate;
+    if (mSweepPhase > 2. * M_PI) mSweepPhase -= 2. * M_PI;
+    return sin(mSweepPhase);
+  }
+
+  double mSampleRate;
+  long long mSectionLength, mPosition;
+  unsigned int mSeed;
+  double mPink[kMaxChannels][7];
+  double mSweepPhase, mKickPhase;
+};
+
+// Scripted automation of drive, mix, mode and crossover frequencies, applied
+// once per block like host automation. A fixed mode (0..NumDistortionModes-1)
+// holds every band on that mode, -1 cycles the modes every few seconds.
+class AutomationScript
+{
+public:
+  AutomationScript(double sampleRate, int fixedMode = -1)
+  : mSampleRate(sampleRate), mFixedMode(fixedMode) {}
+
+  template <typename T>
+  void Apply(MultibandEngineT<T>& engine, long long position)
+  {
+    const double t = (double)position / mSampleRate;
+    for (int j=0; j<4; j++) {
+      const double phase = 2. * M_PI * (0.05 * t + 0.25 * j);
+      engine.SetDrive(j, 16.5 + 19.5 * sin(phase));
+      engine.SetMix(j, 0.75 + 0.25 * cos(1.3 * phase));
+      engine.SetMode(j, mFixedMode >= 0 ? mFixedMode : ((int)(t / 5.) + j) % NumDistortionModes);
+    }
+    // crossovers glide through their own ranges, so they never cross
+    engine.SetCrossover(0, 60. * pow(250. / 60., 0.5 + 0.5 * sin(2. * M_PI * 0.03 * t)));
+    engine.SetCrossover(1, 400. * pow(1500. / 400., 0.5 + 0.5 * sin(2. * M_PI * 0.021 * t)));
+    engine.SetCrossover(2, 2500. * pow(8000. / 2500., 0.5 + 0.5 * sin(2. * M_PI * 0.017 * t)));
+  }
+
+private:
+  double mSampleRate;
+  int mFixedMode;
+};
+
+// Discrete changes the continuous automation does not cover, the ones suspected
+// of causing glitches. Apply() reports the events it fired as a bit mask.
+enum EScriptEvents
+{
+  kEventCrossover = 0,
+  kEventMode,
+  kEventLinked,
+  kEventSolo,
+  kEventAnalyzer,
+  kNumScriptEvents
+};
+
+// Fires one of the events at random intervals, 10 per second on average
+class EventScript
+{
+public:
+  EventScript(double sampleRate) : mSampleRate(sampleRate), mSeed(0x9E3779B9), mNext(0), mLinked(false), mAnalyzer(false)
+  {
+    for (int j=0; j<4; j++) mSolo[j] = false;
+  }
+
+  // fires the events due before position, returns them as a bit mask
+  unsigned int Apply(MultibandEngine& engine, Spect_TapRing* ring, long long position)
+  {
+    unsigned int events = 0;
+    while (mNext <= position) {
+      const int type = Random(kNumScriptEvents);
+      switch (type) {
+        case kEventCrossover: {
+          static const double lo[3] = { 60., 400., 2500. };
+          static const double hi[3] = { 250., 1500., 8000. };
+          const int i = Random(3);
+          engine.SetCrossover(i, lo[i] + (hi[i] - lo[i]) * Random(1000) / 1000.);
+          break;
+        }
+        case kEventMode:
+          engine.SetMode(Random(4), Random(NumDistortionModes));
+          break;
+        case kEventLinked:
+          mLinked = !mLinked;
+          engine.SetLinked(mLinked);
+          break;
+        case kEventSolo: {
+          const int j = Random(4);
+          mSolo[j] = !mSolo[j];
+          engine.SetSolo(j, mSolo[j]);
+          break;
+        }
+        default:
+          mAnalyzer = !mAnalyzer;
+          engine.SetTaps(ring, mAnalyzer ? (1u << kNumTaps) - 1 : 0);
+          break;
+      }
+      events |= 1u << type;
+      mNext += 1 + (long long)(Random(1000) / 1000. * 0.2 * mSampleRate);
+    }
+    return events;
+  }
+
+private:
+  int Random(int n)
+  {
+    mSeed ^= mSeed << 13;
+    mSeed ^= mSeed >> 17;
+    mSeed ^= mSeed << 5;
+    return (int)(mSeed % (unsigned int)n);
+  }
+
+  double mSampleRate;
+  unsigned int mSeed;
+  long long mNext;
+  bool mLinked, mAnalyzer, mSolo[4];
+};
+
+#endif /* ProgramMaterial_h */
@@ -0,0 +1,710 @@
+//
+//  golden.cpp
+//  MultibandDistortion
+//
+//  Golden output regression check. Fixed stimuli are rendered through each DSP
+//  stage and through the whole engine at 44.1, 48 and 96 kHz and compared with
+//  the reference files in regression/references. Every stage has an error
+//  budget for the largest absolute difference, the RMS difference and the
+//  largest spectral difference (dB, over the bins within 80 dB of the
+//  reference's peak). Any stage over budget fails the run.
+//
+//  Variants are alternative implementations of a stage (faster paths,
+//  approximations). They have no references of their own; they are compared
+//  with the reference of the stage they replace, with their own budget.
+//
+//  Checks measure a property directly, where a reference would hide it (its
+//  rounding is coarser than the property) or has nothing to say (state that
+//  is not audio, like a meter). Each measures one number per rate that must
+//  not exceed its limit.
+//
+//  References are 32-bit floats, little endian, one file per stage and rate.
+//  Regenerate them with --update after a change that is meant to alter the
+//  output, and commit them with that change.
+//
+//  Command line:
+//    --update           write the references instead of checking against them
+//    --refs=<dir>       reference directory (default: the one in the source tree)
+//    --filter=<text>    only stages, variants and checks whose name contains <text>
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "LinkwitzRiley.h"
+#include "Distortion.h"
+#include "WaveshaperTables.h"
+#include "CParamSmooth.h"
+#include "PeakFollower.h"
+#include "MultibandEngine.h"
+#include "ProgramMaterial.h"
+#include "fft.h"
+
+#ifndef GOLDEN_REFERENCE_DIR
+#define GOLDEN_REFERENCE_DIR "references"
+#endif
+
+static const int kLength = 4096;
+static const double kRates[] = { 44100., 48000., 96000. };
+static const int kNumRates = sizeof(kRates) / sizeof(kRates[0]);
+
+struct Tolerance
+{
+  double maxAbs, rms, spectralDB;
+};
+
+// the references are stored as floats, so even an exact match differs by their rounding
+static const Tolerance kExact = { 1e-6, 1e-7, 0.01 };
+
+typedef void (*RenderFunction)(double sampleRate, int arg, std::vector<double>& out);
+
+struct Stage
+{
+  const char* name;
+  RenderFunction render;
+  int arg;
+  Tolerance tolerance;
+};
+
+struct Variant
+{
+  const char* name;
+  const char* reference;
+  RenderFunction render;
+  int arg;
+  Tolerance tolerance;
+};
+
+typedef double (*MeasureFunction)(double sampleRate, int arg);
+
+struct Measure
+{
+  const char* name;
+  MeasureFunction measure;
+  int arg;
+  double limit;
+};
+
+// Stimuli
+
+// unit impulse followed by white noise at -6 dBFS
+static std::vector<double> Noise()
+{
+  std::vector<double> v(kLength);
+  unsigned int seed = 0x2545F491;
+  v[0] = 1.;
+  for (int i = 1; i < kLength; i++) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    v[i] = 0.5 * ((double)seed / 2147483648. - 1.);
+  }
+  return v;
+}
+
+// -4 to 4, covers the waveshapers' whole transfer curve
+static std::vector<double> Ramp()
+{
+  std::vector<double> v(kLength);
+  for (int i = 0; i < kLength; i++) v[i] = -4. + 8. * i / (kLength - 1);
+  return v;
+}
+
+// Stages
+
+static void RenderLinkwitzRiley(double sampleRate, int arg, std::vector<double>& out)
+{
+  const std::vector<double> in = Noise();
+  LinkwitzRiley filter(sampleRate, arg ? Highpass : Lowpass, 1000.);
+  out.resize(kLength);
+  for (int i = 0; i < kLength; i++) out[i] = filter.process(in[i], 0);
+}
+
+static void RenderDistortion(double /*sampleRate*/, int arg, std::vector<double>& out)
+{
+  const std::vector<double> in = Ramp();
+  out.resize(kLength);
+  for (int i = 0; i < kLength; i++) out[i] = ProcessDistortion(in[i], arg);
+}
+
+static void RenderDistortionFloat(double /*sampleRate*/, int arg, std::vector<double>& out)
+{
+  const std::vector<double> in = Ramp();
+  out.resize(kLength);
+  for (int i = 0; i < kLength; i++) out[i] = ProcessDistortion((float)in[i], arg);
+}
+
+template <typename T>
+static void RenderDistortionFastT(int arg, std::vector<double>& out)
+{
+  const std::vector<double> in = Ramp();
+  std::vector<T> shaped(in.begin(), in.end());
+  ProcessDistortionFast(&shaped[0], kLength, arg);
+  out.assign(shaped.begin(), shaped.end());
+}
+
+static void RenderDistortionFast(double /*sampleRate*/, int arg, std::vector<double>& out)
+{
+  RenderDistortionFastT<double>(arg, out);
+}
+
+static void RenderDistortionFastFloat(double /*sampleRate*/, int arg, std::vector<double>& out)
+{
+  RenderDistortionFastT<float>(arg, out);
+}
+
+// steps 0 -> 1 -> 0
+static void RenderSmoother(double sampleRate, int /*arg*/, std::vector<double>& out)
+{
+  CParamSmooth smoother(5.0, sampleRate);
+  out.resize(kLength);
+  for (int i = 0; i < kLength; i++) out[i] = smoother.process(i < kLength / 2 ? 1. : 0.);
+}
+
+static void RenderPeakFollower(double sampleRate, int /*arg*/, std::vector<double>& out)
+{
+  const std::vector<double> in = Noise();
+  PeakFollower follower(sampleRate);
+  out.resize(kLength);
+  for (int i = 0; i < kLength; i++) out[i] = follower.process(in[i]);
+}
+
+enum EChainFlags { kChainLinked = 1, kChainTaps = 2, kChainSplit = 4, kChainFloat = 8, kChainSurround = 16, kChainParallel = 32,
+                   kChainGaps = 64, kChainNoSkip = 128, kChainSolo = 256, kChainMute = 512,
+                   kChainSwitch = 1024, kChainMultirate = 2048, kChainOversample = 4096,
+                   kChainOversample4x = 8192, kChainChebyshev = 16384, kChainFast = 32768 };
+
+// program material through the whole engine, both channels one after the other
+template <typename T>
+static void RenderChainT(double sampleRate, int arg, std::vector<double>& out)
+{
+  ProgramMaterial material(sampleRate, kLength / 4 / sampleRate);
+  MultibandEngineT<T> engine(sampleRate);
+  static const int modes[4] = { DistExcite, DistSine, DistFold, DistTanh };
+  for (int j = 0; j < 4; j++) {
+    engine.SetDrive(j, 6. + 4. * j);
+    engine.SetMix(j, 0.8);
+    engine.SetMode(j, (arg & kChainChebyshev) ? DistChebyshev : modes[j]);
+  }
+  engine.SetLinked((arg & kChainLinked) != 0);
+  engine.SetSilenceSkip((arg & kChainNoSkip) == 0);
+  engine.SetFastShapers((arg & kChainFast) != 0);
+  engine.SetMultirate((arg & kChainMultirate) != 0);
+  //oversampled: fixed factors, and auto on a low band (1x) and the top band (8x)
+  if (arg & kChainOversample) {
+    static const int factors[4] = { 2, 0, 1, 0 };
+    for (int j = 0; j < 4; j++) engine.SetOversampling(j, factors[j]);
+  }
+  //all at 4x: one shared decimator, unless on the pool or tapped
+  if (arg & kChainOversample4x) {
+    for (int j = 0; j < 4; j++) engine.SetOversampling(j, 4);
+  }
+  //solo band 3, or mute the outer bands
+  engine.SetSolo(2, (arg & kChainSolo) != 0);
+  engine.SetMute(0, (arg & kChainMute) != 0);
+  engine.SetMute(3, (arg & kChainMute) != 0);
+  //gaps: crossovers high enough for the filterbank to ring out within the gap
+  if (arg & kChainGaps) {
+    engine.SetCrossover(0, 400.);
+    engine.SetCrossover(1, 1500.);
+    engine.SetCrossover(2, 6000.);
+  }
+  Spect_TapRing ring(kNumTaps, 1 << 14);
+  if (arg & kChainTaps) engine.SetTaps(&ring, (1u << kNumTaps) - 1);
+  WorkerPool pool((arg & kChainParallel) ? 3 : 0);
+  if (arg & kChainParallel) engine.SetWorkerPool(&pool, 1);
+
+  //surround: 7 channels, alternately carrying the left and right material
+  const int nChannels = (arg & kChainSurround) ? 7 : 2;
+  std::vector<double> generated[2];
+  std::vector<T> in[kMaxChannels], result[kMaxChannels];
+  T* inputs[kMaxChannels];
+  T* outputs[kMaxChannels];
+  for (int c = 0; c < 2; c++) generated[c].resize(kLength);
+  double* channels[2] = { &generated[0][0], &generated[1][0] };
+  material.Render(channels, 2, kLength);
+  if (arg & kChainGaps) {
+    for (int c = 0; c < 2; c++) std::fill(generated[c].begin() + kLength / 4, generated[c].begin() + 3 * kLength / 4, 0.);
+  }
+  for (int c = 0; c < nChannels; c++) {
+    in[c].assign(generated[c % 2].begin(), generated[c % 2].end());
+    result[c].resize(kLength);
+    inputs[c] = &in[c][0];
+    outputs[c] = &result[c][0];
+  }
+
+  std::vector<T> split[4][kMaxChannels];
+  T* bandChannels[4][kMaxChannels];
+  T** bands[4];
+  for (int j = 0; j < 4; j++) {
+    for (int c = 0; c < nChannels; c++) {
+      split[j][c].resize(256);
+      bandChannels[j][c] = &split[j][c][0];
+    }
+    bands[j] = bandChannels[j];
+  }
+
+  //in blocks, so the taps are published on the way
+  for (int pos = 0; pos < kLength; pos += 256) {
+    T* blockIn[kMaxChannels];
+    T* blockOut[kMaxChannels];
+    for (int c = 0; c < nChannels; c++) {
+      blockIn[c] = inputs[c] + pos;
+      blockOut[c] = outputs[c] + pos;
+    }
+    //switch: linked and back, then new modes, all crossfaded
+    if (arg & kChainSwitch) {
+      if (pos == 4 * 256) engine.SetLinked(true);
+      if (pos == 8 * 256) engine.SetLinked(false);
+      if (pos == 12 * 256) {
+        for (int j = 0; j < 4; j++) engine.SetMode(j, modes[3 - j]);
+      }
+    }
+    if (arg & kChainSplit) {
+      engine.SplitBlock(blockIn, bands, nChannels, 256);
+      engine.ProcessBands(bands, blockOut, nChannels, 256);
+    }
+    else engine.ProcessBlock(blockIn, blockOut, nChannels, 256);
+    ring.Discard();
+  }
+
+  //the last left and right channels, so the surround run is held to the stereo reference
+  const int left = (nChannels - 1) & ~1, right = nChannels == 2 ? 1 : nChannels - 2;
+  out.assign(result[left].begin(), result[left].end());
+  out.insert(out.end(), result[right].begin(), result[right].end());
+}
+
+static void RenderChain(double sampleRate, int arg, std::vector<double>& out)
+{
+  if (arg & kChainFloat) RenderChainT<float>(sampleRate, arg, out);
+  else RenderChainT<double>(sampleRate, arg, out);
+}
+
+static const Stage kStages[] =
+{
+  { "lr_lowpass", RenderLinkwitzRiley, 0, kExact },
+  { "lr_highpass", RenderLinkwitzRiley, 1, kExact },
+  { "dist_excite", RenderDistortion, DistExcite, kExact },
+  { "dist_fat", RenderDistortion, DistFat, kExact },
+  { "dist_sine", RenderDistortion, DistSine, kExact },
+  { "dist_fold", RenderDistortion, DistFold, kExact },
+  { "dist_tanh", RenderDistortion, DistTanh, kExact },
+  { "dist_soft", RenderDistortion, DistSoft, kExact },
+  { "dist_chebyshev", RenderDistortion, DistChebyshev, kExact },
+  { "smoother", RenderSmoother, 0, kExact },
+  { "peak_follower", RenderPeakFollower, 0, kExact },
+  { "chain", RenderChain, 0, kExact },
+  { "chain_linked", RenderChain, kChainLinked, kExact },
+  { "chain_gaps", RenderChain, kChainGaps | kChainNoSkip, kExact },
+  { "chain_solo", RenderChain, kChainSolo, kExact },
+  { "chain_mute", RenderChain, kChainMute, kExact },
+  { "chain_switch", RenderChain, kChainSwitch, kExact },
+  { "chain_multirate", RenderChain, kChainMultirate, kExact },
+  { "chain_multirate_switch", RenderChain, kChainMultirate | kChainSwitch, kExact },
+  { "chain_oversampled", RenderChain, kChainOversample, kExact },
+  { "chain_oversampled_switch", RenderChain, kChainOversample | kChainSwitch, kExact },
+  { "chain_oversampled_multirate", RenderChain, kChainOversample | kChainMultirate, kExact },
+  { "chain_oversampled_4x", RenderChain, kChainOversample4x | kChainSwitch, kExact },
+  { "chain_chebyshev", RenderChain, kChainChebyshev, kExact },
+  { "chain_chebyshev_oversampled", RenderChain, kChainChebyshev | kChainOversample, kExact },
+};
+
+static const Variant kVariants[] =
+{
+  //writing the analyzer taps must not touch the audio
+  { "chain_taps", "chain", RenderChain, kChainTaps, { 0., 0., 0. } },
+  //the two pass split used by the sweep renderer
+  { "chain_split", "chain", RenderChain, kChainSplit, { 0., 0., 0. } },
+  //the float engine and waveshapers, single precision rounding throughout
+  { "dist_excite_float", "dist_excite", RenderDistortionFloat, DistExcite, { 1e-5, 1e-6, 0.01 } },
+  { "dist_fat_float", "dist_fat", RenderDistortionFloat, DistFat, { 1e-5, 1e-6, 0.01 } },
+  { "dist_sine_float", "dist_sine", RenderDistortionFloat, DistSine, { 1e-5, 1e-6, 0.01 } },
+  { "dist_fold_float", "dist_fold", RenderDistortionFloat, DistFold, { 1e-5, 1e-6, 0.01 } },
+  { "dist_tanh_float", "dist_tanh", RenderDistortionFloat, DistTanh, { 1e-5, 1e-6, 0.01 } },
+  { "dist_soft_float", "dist_soft", RenderDistortionFloat, DistSoft, { 1e-5, 1e-6, 0.01 } },
+  { "dist_chebyshev_float", "dist_chebyshev", RenderDistortionFloat, DistChebyshev, { 1e-5, 1e-6, 0.01 } },
+  { "chain_float", "chain", RenderChain, kChainFloat, { 1e-5, 1e-6, 0.05 } },
+  //the table driven waveshapers: in double their error is below the references'
+  //rounding, so these only hold them to it; the checks hold them to their bounds
+  { "dist_sine_fast", "dist_sine", RenderDistortionFast, DistSine, { 1e-7, 1e-8, 0.01 } },
+  { "dist_fold_fast", "dist_fold", RenderDistortionFast, DistFold, { 1e-7, 1e-8, 0.01 } },
+  { "dist_tanh_fast", "dist_tanh", RenderDistortionFast, DistTanh, { 1e-7, 1e-8, 0.01 } },
+  { "dist_sine_fast_float", "dist_sine", RenderDistortionFastFloat, DistSine, { 1e-5, 1e-6, 0.01 } },
+  { "dist_fold_fast_float", "dist_fold", RenderDistortionFastFloat, DistFold, { 1e-5, 1e-6, 0.01 } },
+  { "dist_tanh_fast_float", "dist_tanh", RenderDistortionFastFloat, DistTanh, { 1e-5, 1e-6, 0.01 } },
+  { "chain_fast", "chain", RenderChain, kChainFast, { 1e-7, 1e-8, 0.05 } },
+  { "chain_fast_float", "chain", RenderChain, kChainFast | kChainFloat, { 1e-5, 1e-6, 0.05 } },
+  { "chain_oversampled_fast", "chain_oversampled", RenderChain, kChainOversample | kChainFast, { 1e-7, 1e-8, 0.05 } },
+  { "chain_linked_float", "chain_linked", RenderChain, kChainLinked | kChainFloat, { 1e-5, 1e-6, 0.05 } },
+  { "chain_chebyshev_float", "chain_chebyshev", RenderChain, kChainChebyshev | kChainFloat, { 1e-5, 1e-6, 0.05 } },
+  //channels are independent, however many there are
+  { "chain_surround", "chain", RenderChain, kChainSurround, { 0., 0., 0. } },
+  { "chain_surround_split", "chain", RenderChain, kChainSurround | kChainSplit, { 0., 0., 0. } },
+  //bands on the worker pool
+  { "chain_parallel", "chain", RenderChain, kChainParallel | kChainTaps, { 0., 0., 0. } },
+  { "chain_surround_parallel", "chain", RenderChain, kChainSurround | kChainParallel, { 0., 0., 0. } },
+  //bands left out of the output are left out of the work on the pool too
+  { "chain_solo_parallel", "chain_solo", RenderChain, kChainSolo | kChainParallel, { 0., 0., 0. } },
+  { "chain_mute_parallel", "chain_mute", RenderChain, kChainMute | kChainParallel, { 0., 0., 0. } },
+  //mode fades on the pool, the linked fade runs serially
+  { "chain_switch_parallel", "chain_switch", RenderChain, kChainSwitch | kChainParallel, { 0., 0., 0. } },
+  //silent blocks skipped, the tail below the silence threshold dropped
+  { "chain_gaps_skip", "chain_gaps", RenderChain, kChainGaps | kChainTaps, { 1e-6, 1e-7, 0.05 } },
+  //decimated bands and their delays on the pool and in the two pass split
+  { "chain_multirate_parallel", "chain_multirate", RenderChain, kChainMultirate | kChainParallel, { 0., 0., 0. } },
+  { "chain_multirate_split", "chain_multirate", RenderChain, kChainMultirate | kChainSplit, { 0., 0., 0. } },
+  { "chain_multirate_switch_parallel", "chain_multirate_switch", RenderChain, kChainMultirate | kChainSwitch | kChainParallel, { 0., 0., 0. } },
+  //the oversamplers on the pool and in the two pass split
+  { "chain_oversampled_parallel", "chain_oversampled", RenderChain, kChainOversample | kChainParallel, { 0., 0., 0. } },
+  { "chain_oversampled_split", "chain_oversampled", RenderChain, kChainOversample | kChainSplit, { 0., 0., 0. } },
+  //each band's Chebyshev order follows its factor, on the pool too
+  { "chain_chebyshev_oversampled_parallel", "chain_chebyshev_oversampled", RenderChain, kChainChebyshev | kChainOversample | kChainParallel, { 0., 0., 0. } },
+  { "chain_oversampled_multirate_parallel", "chain_oversampled_multirate", RenderChain, kChainOversample | kChainMultirate | kChainParallel, { 0., 0., 0. } },
+  //the bands' own decimators against the shared one, makeup and mix on the
+  //high rate frames in both: the same audio up to the order of the sums
+  { "chain_oversampled_4x_parallel", "chain_oversampled_4x", RenderChain, kChainOversample4x | kChainSwitch | kChainParallel, { 0., 0., 0. } },
+  { "chain_oversampled_4x_taps", "chain_oversampled_4x", RenderChain, kChainOversample4x | kChainSwitch | kChainTaps, { 0., 0., 0. } },
+};
+
+// Checks
+
+enum EMeterFlags { kMeterMute = 1, kMeterSolo = 2, kMeterBypass = 4 };
+
+// Band 2's meter after a second of silence, as a fraction of its level when the
+// band was muted, left out by a solo or bypassed: the peak follower halves in
+// half a second, so it reads 0.25; a meter held where it was reads 1. Most of
+// the silent blocks are skipped, the rest run the band as it is left out.
+static double MeasureMeterFall(double sampleRate, int arg)
+{
+  const int block = 256;
+  const int sound = (int)(0.25 * sampleRate) / block * block, silence = (int)sampleRate / block * block;
+  ProgramMaterial material(sampleRate, 1.);
+  MultibandEngineT<double> engine(sampleRate);
+  std::vector<double> left(block), right(block);
+  double* channels[2] = { &left[0], &right[0] };
+  for (int pos = 0; pos < sound; pos += block) {
+    material.Render(channels, 2, block);
+    engine.ProcessBlock(channels, channels, 2, block);
+  }
+  const double before = engine.GetMeterLevel(1);
+  engine.SetMute(1, (arg & kMeterMute) != 0);
+  engine.SetSolo(2, (arg & kMeterSolo) != 0);
+  engine.SetEnable(1, (arg & kMeterBypass) == 0);
+  for (int pos = 0; pos < silence; pos += block) {
+    std::fill(left.begin(), left.end(), 0.);
+    std::fill(right.begin(), right.end(), 0.);
+    engine.ProcessBlock(channels, channels, 2, block);
+  }
+  return pow(10., engine.GetMeterLevel(1) - before);
+}
+
+static void Spectrum(const double* x, std::vector<double>& dB);
+
+enum EAliasFlags { kAliasTopBand = 1, kAliasLinked = 2 };
+
+// A sine through the Chebyshev mode at 1x, with band 3 soloed, band 4 (the
+// top band) soloed with kAliasTopBand, or the controls linked: the loudest bin
+// that is not a harmonic of the sine, in dB below the loudest bin. Every
+// harmonic the order allows lies under Nyquist, so nothing folds back onto the
+// bins in between; the top band and the linked path, whose edge is Nyquist,
+// come out unshaped. The sine sits on an odd bin, so no alias lands on a
+// harmonic's bin either.
+static double MeasureChebyshevAliasing(double sampleRate, int arg)
+{
+  const double freq = (arg & (kAliasTopBand | kAliasLinked)) ? 0.3 * sampleRate : 3000.;
+  const int bin = (int)(freq / sampleRate * kLength + 0.5) | 1;
+  MultibandEngineT<double> engine(sampleRate);
+  for (int j = 0; j < 4; j++) {
+    engine.SetMode(j, DistChebyshev);
+    engine.SetDrive(j, 0.);
+  }
+  engine.SetSolo((arg & kAliasTopBand) ? 3 : 2, true);
+  engine.SetLinked((arg & kAliasLinked) != 0);
+  //the last of three lengths, the filters settled
+  std::vector<double> left(3 * kLength), right;
+  for (int i = 0; i < 3 * kLength; i++) left[i] = 0.5 * sin(2. * M_PI * bin * i / kLength);
+  right = left;
+  double* channels[2] = { &left[0], &right[0] };
+  for (int pos = 0; pos < 3 * kLength; pos += 256) {
+    double* block[2] = { channels[0] + pos, channels[1] + pos };
+    engine.ProcessBlock(block, block, 2, 256);
+  }
+  std::vector<double> dB;
+  Spectrum(&left[2 * kLength], dB);
+  const double peak = *std::max_element(dB.begin(), dB.end());
+  double loudest = -400.;
+  for (int k = 0; k < kLength / 2; k++) {
+    //the Hann window spreads each harmonic over its neighbours
+    const int offset = k % bin;
+    if (offset <= 1 || offset >= bin - 1) continue;
+    loudest = std::max(loudest, dB[k] - peak);
+  }
+  return loudest;
+}
+
+enum EGapFlags { kGapUp = 1, kGapOversampled = 2 };
+
+// Two low sines through the multirate engine while the bottom crossover moves
+// from 112 Hz to freq, against the host rate engine making the same move: the
+// lowest ratio of their RMS over 256 frames around the move.
+static double LowestMultirateRatio(double sampleRate, bool oversampled, double freq)
+{
+  const int block = 64, move = 300 * block, length = 600 * block;
+  MultibandEngineT<double> multirate(sampleRate), host(sampleRate);
+  multirate.SetMultirate(true);
+  for (int j = 0; j < 4; j++) {
+    multirate.SetMode(j, DistSoft);
+    host.SetMode(j, DistSoft);
+    if (oversampled) {
+      multirate.SetOversampling(j, 2);
+      host.SetOversampling(j, 2);
+    }
+  }
+  const int latency = multirate.GetLatencySamples() - host.GetLatencySamples();
+  std::vector<double> a(length), b(length), right(block);
+  for (int i = 0; i < length; i++) a[i] = 0.3 * sin(2. * M_PI * 70. * i / sampleRate) + 0.2 * sin(2. * M_PI * 40. * i / sampleRate);
+  b = a;
+  for (int pos = 0; pos < length; pos += block) {
+    if (pos == move) {
+      multirate.SetCrossover(0, freq);
+      host.SetCrossover(0, freq);
+    }
+    std::copy(&a[pos], &a[pos] + block, right.begin());
+    double* channels[2] = { &a[pos], &right[0] };
+    multirate.ProcessBlock(channels, channels, 2, block);
+    std::copy(&b[pos], &b[pos] + block, right.begin());
+    channels[0] = &b[pos];
+    host.ProcessBlock(channels, channels, 2, block);
+  }
+  double lowest = 1.;
+  for (int n = move - 2000; n < move + latency + 4000; n += 16) {
+    double ea = 0., eb = 0.;
+    for (int k = 0; k < 256; k++) {
+      ea += a[n + k] * a[n + k];
+      eb += b[n + k - latency] * b[n + k - latency];
+    }
+    lowest = std::min(lowest, sqrt(ea / eb));
+  }
+  return lowest;
+}
+
+// The bottom crossover moved up to 250 Hz (kGapUp) or down to 60 Hz, which
+// changes band 1's rate factor at every rate: one less the lowest ratio over
+// the same for a move to where it is. Every move restarts the crossover filters,
+// whose step the decimated band follows less closely; a band that drops what
+// its old path still held falls to a third of that or less.
+static double MeasureMultirateGap(double sampleRate, int arg)
+{
+  const bool oversampled = (arg & kGapOversampled) != 0;
+  return 1. - LowestMultirateRatio(sampleRate, oversampled, (arg & kGapUp) ? 250. : 60.) / LowestMultirateRatio(sampleRate, oversampled, 112.);
+}
+
+// The fast waveshapers against the exact ones, in double, on every multiple of
+// 2^-16 in [-8, 8] and on |x| from 8 to 2e9 in steps of 0.01%: the largest
+// error over max(1, |x|). Past 1 that holds Fold, whose rounding grows with
+// |x|, to its relative bound; the tables end before 8.
+static double MeasureFastShaper(double /*sampleRate*/, int arg)
+{
+  std::vector<double> x;
+  for (int i = -8 * 65536; i <= 8 * 65536; i++) x.push_back(i / 65536.);
+  for (double a = 8.; a < 2e9; a *= 1.0001) {
+    x.push_back(a);
+    x.push_back(-a);
+  }
+  std::vector<double> fast = x;
+  ProcessDistortionFast(&fast[0], (int)fast.size(), arg);
+  double largest = 0.;
+  for (size_t i = 0; i < x.size(); i++) {
+    const double error = fabs(fast[i] - ProcessDistortion(x[i], arg)) / std::max(1., fabs(x[i]));
+    largest = std::max(largest, error);
+  }
+  return largest;
+}
+
+static const Measure kChecks[] =
+{
+  //the meters of bands that make no sound fall, on skipped silent blocks too
+  { "meter_mute_falls", MeasureMeterFall, kMeterMute, 0.3 },
+  { "meter_solo_falls", MeasureMeterFall, kMeterSolo, 0.3 },
+  { "meter_bypass_falls", MeasureMeterFall, kMeterBypass, 0.3 },
+  //the bounds WaveshaperTables.h gives, finer than any reference can hold
+  { "dist_tanh_fast_bound", MeasureFastShaper, DistTanh, 2.2e-9 },
+  { "dist_sine_fast_bound", MeasureFastShaper, DistSine, 1.4e-9 },
+  { "dist_fold_fast_bound", MeasureFastShaper, DistFold, 1.4e-15 },
+  //the Chebyshev mode without oversampling: no harmonic above Nyquist, in dB
+  { "chebyshev_band3_aliasing", MeasureChebyshevAliasing, 0, -100. },
+  { "chebyshev_top_aliasing", MeasureChebyshevAliasing, kAliasTopBand, -100. },
+  { "chebyshev_linked_aliasing", MeasureChebyshevAliasing, kAliasLinked, -100. },
+  //a multirate band's old path played out when a crossover changes its factor
+  { "multirate_gap_up", MeasureMultirateGap, kGapUp, 0.2 },
+  { "multirate_gap_down", MeasureMultirateGap, 0, 0.2 },
+  { "multirate_gap_up_oversampled", MeasureMultirateGap, kGapUp | kGapOversampled, 0.2 },
+  { "multirate_gap_down_oversampled", MeasureMultirateGap, kGapOversampled, 0.2 },
+};
+
+// Comparison
+
+struct Errors
+{
+  double maxAbs, rms, spectralDB;
+};
+
+// Hann windowed magnitude spectrum of one segment, in dB
+static void Spectrum(const double* x, std::vector<double>& dB)
+{
+  std::vector<WDL_FFT_COMPLEX> buffer(kLength);
+  for (int i = 0; i < kLength; i++) {
+    const double w = 0.5 - 0.5 * cos(2. * M_PI * i / kLength);
+    buffer[i].re = (WDL_FFT_REAL)(x[i] * w);
+    buffer[i].im = 0;
+  }
+  WDL_fft(&buffer[0], kLength, 0);
+  dB.resize(kLength / 2);
+  for (int k = 0; k < kLength / 2; k++) {
+    const WDL_FFT_COMPLEX& c = buffer[WDL_fft_permute(kLength, k)];
+    dB[k] = 10. * log10((double)c.re * c.re + (double)c.im * c.im + 1e-30);
+  }
+}
+
+static Errors Compare(const std::vector<double>& result, const std::vector<double>& reference)
+{
+  Errors e = { 0., 0., 0. };
+  for (size_t i = 0; i < result.size(); i++) {
+    const double d = fabs(result[i] - reference[i]);
+    e.maxAbs = std::max(e.maxAbs, d);
+    e.rms += d * d;
+  }
+  e.rms = sqrt(e.rms / result.size());
+
+  std::vector<double> a, b;
+  for (size_t pos = 0; pos + kLength <= result.size(); pos += kLength) {
+    Spectrum(&result[pos], a);
+    Spectrum(&reference[pos], b);
+    const double peak = *std::max_element(b.begin(), b.end());
+    for (size_t k = 0; k < b.size(); k++) {
+      if (b[k] > peak - 80.) e.spectralDB = std::max(e.spectralDB, fabs(a[k] - b[k]));
+    }
+  }
+  return e;
+}
+
+static std::string ReferencePath(const std::string& dir, const char* stage, double sampleRate)
+{
+  char name[128];
+  snprintf(name, sizeof(name), "/%s_%d.f32", stage, (int)sampleRate);
+  return dir + name;
+}
+
+static bool ReadReference(const std::string& path, std::vector<double>& data)
+{
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) return false;
+  std::vector<float> buffer;
+  float chunk[1024];
+  size_t n;
+  while ((n = fread(chunk, sizeof(float), 1024, f)) > 0) buffer.insert(buffer.end(), chunk, chunk + n);
+  fclose(f);
+  data.assign(buffer.begin(), buffer.end());
+  return true;
+}
+
+static bool WriteReference(const std::string& path, const std::vector<double>& data)
+{
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) return false;
+  const std::vector<float> buffer(data.begin(), data.end());
+  const bool ok = fwrite(&buffer[0], sizeof(float), buffer.size(), f) == buffer.size();
+  return fclose(f) == 0 && ok;
+}
+
+// prints one result line, returns false if over budget
+static bool Check(const char* name, double sampleRate, const std::vector<double>& result, const std::string& path, const Tolerance& tolerance)
+{
+  std::vector<double> reference;
+  if (!ReadReference(path, reference)) {
+    printf("%-24s %6d  missing reference %s (run with --update)\n", name, (int)sampleRate, path.c_str());
+    return false;
+  }
+  if (reference.size() != result.size()) {
+    printf("%-24s %6d  FAIL  reference has %d samples, output %d\n", name, (int)sampleRate, (int)reference.size(), (int)result.size());
+    return false;
+  }
+  const Errors e = Compare(result, reference);
+  const bool pass = e.maxAbs <= tolerance.maxAbs && e.rms <= tolerance.rms && e.spectralDB <= tolerance.spectralDB;
+  printf("%-24s %6d  %-4s %12.3g %12.3g %12.4f\n", name, (int)sampleRate, pass ? "ok" : "FAIL", e.maxAbs, e.rms, e.spectralDB);
+  return pass;
+}
+
+int main(int argc, char** argv)
+{
+  bool update = false;
+  std::string refs = GOLDEN_REFERENCE_DIR;
+  std::string filter;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--update")) update = true;
+    else if (!strncmp(argv[i], "--refs=", 7)) refs = argv[i] + 7;
+    else if (!strncmp(argv[i], "--filter=", 9)) filter = argv[i] + 9;
+    else {
+      fprintf(stderr, "usage: %s [--update] [--refs=<dir>] [--filter=<text>]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  WDL_fft_init();
+  int failures = 0;
+  std::vector<double> result;
+
+  if (!update) printf("%-24s %6s  %-4s %12s %12s %12s\n", "Stage", "Rate", "", "max abs", "RMS", "spectral dB");
+  for (size_t s = 0; s < sizeof(kStages) / sizeof(kStages[0]); s++) {
+    const Stage& stage = kStages[s];
+    if (!filter.empty() && std::string(stage.name).find(filter) == std::string::npos) continue;
+    for (int r = 0; r < kNumRates; r++) {
+      stage.render(kRates[r], stage.arg, result);
+      const std::string path = ReferencePath(refs, stage.name, kRates[r]);
+      if (update) {
+        if (!WriteReference(path, result)) {
+          fprintf(stderr, "could not write %s\n", path.c_str());
+          return 1;
+        }
+        printf("wrote %s\n", path.c_str());
+      }
+      else if (!Check(stage.name, kRates[r], result, path, stage.tolerance)) failures++;
+    }
+  }
+  if (update) return 0;
+
+  for (size_t v = 0; v < sizeof(kVariants) / sizeof(kVariants[0]); v++) {
+    const Variant& variant = kVariants[v];
+    if (!filter.empty() && std::string(variant.name).find(filter) == std::string::npos) continue;
+    for (int r = 0; r < kNumRates; r++) {
+      variant.render(kRates[r], variant.arg, result);
+      //no budget can be tighter than the rounding of the stored reference
+      Tolerance tolerance = variant.tolerance;
+      tolerance.maxAbs = std::max(tolerance.maxAbs, kExact.maxAbs);
+      tolerance.rms = std::max(tolerance.rms, kExact.rms);
+      tolerance.spectralDB = std::max(tolerance.spectralDB, kExact.spectralDB);
+      if (!Check(variant.name, kRates[r], result, ReferencePath(refs, variant.reference, kRates[r]), tolerance)) failures++;
+    }
+  }
+
+  printf("%-24s %6s  %-4s %12s %12s\n", "Check", "Rate", "", "value", "limit");
+  for (size_t m = 0; m < sizeof(kChecks) / sizeof(kChecks[0]); m++) {
+    const Measure& check = kChecks[m];
+    if (!filter.empty() && std::string(check.name).find(filter) == std::string::npos) continue;
+    for (int r = 0; r < kNumRates; r++) {
+      const double value = check.measure(kRates[r], check.arg);
+      const bool pass = value <= check.limit;
+      printf("%-24s %6d  %-4s %12.3g %12.3g\n", check.name, (int)kRates[r], pass ? "ok" : "FAIL", value, check.limit);
+      if (!pass) failures++;
+    }
+  }
+
+  if (failures) printf("%d check(s) failed\n", failures);
+  else printf("all checks passed\n");
+  return failures ? 1 : 0;
+}
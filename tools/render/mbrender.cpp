@@ -0,0 +1,219 @@
+//
+//  mbrender.cpp
+//  MultibandDistortion
+//
+//  Offline batch renderer: runs WAV/AIFF files through the plugin's signal path
+//  (MultibandEngine) without IPlug or a host, with the settings of a parameter
+//  file (see ParameterFile.h). Files are spread over a pool of worker threads,
+//  each with its own engine; every file is streamed from a memory mapping in
+//  fixed-size blocks, so memory use does not depend on the file length.
+//
+//  Files of up to 16 channels are supported. Output is WAV, one file per input,
+//  named after the input.
+//
+//  mbrender [options] --out=<dir> <input>...
+//    --out=<dir>          output directory
+//    --params=<file>      parameter file
+//    --set=<name=value>   a single parameter, applied after --params (repeatable)
+//    --list=<file>        more inputs, one path per line
+//    --threads=<n>        worker threads (default: one per core)
+//    --block-size=<n>     samples per processing block (default 512)
+//    --format=<f>         16, 24 or float (default float)
+//    --suffix=<text>      appended to the output file names
+//    --multirate          low bands decimated
+//
+//  The engine's latency, in multirate mode or with oversampling, is trimmed so
+//  the output lines up with the input.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MultibandEngine.h"
+#include "ParameterFile.h"
+#include "AudioFile.h"
+
+struct RenderJob
+{
+  std::vector<std::string> inputs;
+  std::string outputDir, suffix;
+  ParameterFile parameters;
+  AudioFileWriter::Format format;
+  int threads, blockSize;
+  bool multirate;
+};
+
+static std::mutex gPrintMutex;
+
+static std::string OutputPath(const RenderJob& job, const std::string& input)
+{
+  const size_t slash = input.find_last_of("/\\");
+  std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+  const size_t dot = name.find_last_of('.');
+  if (dot != std::string::npos && dot > 0) name.erase(dot);
+  return job.outputDir + "/" + name + job.suffix + ".wav";
+}
+
+// renders one file with the worker's engine, returns seconds of audio, or -1 on failure
+static double RenderFile(const RenderJob& job, MultibandEngine& engine, const std::string& input, std::string& error)
+{
+  AudioFileReader reader;
+  if (!reader.Open(input, error)) return -1.;
+  const int nChannels = reader.GetNumChannels();
+  if (nChannels > kMaxChannels) {
+    error = input + ": too many channels";
+    return -1.;
+  }
+
+  const std::string output = OutputPath(job, input);
+  if (output == input) {
+    error = input + ": output would overwrite the input";
+    return -1.;
+  }
+
+  //a fresh engine state for every file
+  engine.SetSampleRate(reader.GetSampleRate());
+  job.parameters.Apply(engine);
+
+  AudioFileWriter writer;
+  if (!writer.Open(output, nChannels, reader.GetSampleRate(), job.format, error)) return -1.;
+
+  std::vector<double> in[kMaxChannels], out[kMaxChannels];
+  double* inputs[kMaxChannels];
+  double* outputs[kMaxChannels];
+  for (int c = 0; c < nChannels; c++) {
+    in[c].resize(job.blockSize);
+    out[c].resize(job.blockSize);
+    inputs[c] = &in[c][0];
+    outputs[c] = &out[c][0];
+  }
+
+  //the first latency frames out are from before the file started, and as many
+  //frames of silence after the end bring out the rest
+  const int latency = engine.GetLatencySamples();
+  int skip = latency, flush = latency;
+  bool ok = true;
+  int n;
+  while (ok && ((n = reader.Read(inputs, job.blockSize)) > 0 || flush > 0)) {
+    if (n <= 0) {
+      n = std::min(flush, job.blockSize);
+      flush -= n;
+      for (int c = 0; c < nChannels; c++) std::fill(in[c].begin(), in[c].begin() + n, 0.);
+    }
+    engine.ProcessBlock(inputs, outputs, nChannels, n);
+    const int skipped = std::min(skip, n);
+    skip -= skipped;
+    if (skipped == n) continue;
+    double* written[kMaxChannels];
+    for (int c = 0; c < nChannels; c++) written[c] = outputs[c] + skipped;
+    ok = writer.Write(written, n - skipped);
+  }
+  if (!writer.Close()) {
+    error = output + ": write failed";
+    return -1.;
+  }
+  return reader.GetNumFrames() / reader.GetSampleRate();
+}
+
+int main(int argc, char** argv)
+{
+  RenderJob job;
+  job.format = AudioFileWriter::Float32;
+  job.threads = std::max(1, (int)std::thread::hardware_concurrency());
+  job.blockSize = 512;
+  job.multirate = false;
+
+  std::string error;
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    bool ok = true;
+    if (!strncmp(a, "--out=", 6)) job.outputDir = a + 6;
+    else if (!strncmp(a, "--params=", 9)) ok = job.parameters.Load(a + 9, error);
+    else if (!strncmp(a, "--set=", 6)) ok = job.parameters.Parse(a + 6, error);
+    else if (!strncmp(a, "--suffix=", 9)) job.suffix = a + 9;
+    else if (!strncmp(a, "--threads=", 10)) ok = (job.threads = atoi(a + 10)) > 0;
+    else if (!strncmp(a, "--block-size=", 13)) ok = (job.blockSize = atoi(a + 13)) > 0;
+    else if (!strcmp(a, "--format=16")) job.format = AudioFileWriter::PCM16;
+    else if (!strcmp(a, "--format=24")) job.format = AudioFileWriter::PCM24;
+    else if (!strcmp(a, "--format=float")) job.format = AudioFileWriter::Float32;
+    else if (!strcmp(a, "--multirate")) job.multirate = true;
+    else if (!strncmp(a, "--list=", 7)) {
+      FILE* f = fopen(a + 7, "r");
+      if (!f) {
+        ok = false;
+        error = std::string("can not open ") + (a + 7);
+      }
+      else {
+        char line[4096];
+        while (fgets(line, sizeof(line), f)) {
+          std::string path = line;
+          path.erase(path.find_last_not_of(" \t\r\n") + 1);
+          if (!path.empty()) job.inputs.push_back(path);
+        }
+        fclose(f);
+      }
+    }
+    else if (a[0] != '-') job.inputs.push_back(a);
+    else {
+      ok = false;
+      error = std::string("unknown option ") + a;
+    }
+    if (!ok) {
+      fprintf(stderr, "%s\n", error.empty() ? (std::string("invalid value: ") + a).c_str() : error.c_str());
+      return 1;
+    }
+  }
+  if (job.outputDir.empty() || job.inputs.empty()) {
+    fprintf(stderr, "usage: %s [--params=<file>] [--set=<name=value>]... [--list=<file>] [--threads=<n>] [--block-size=<n>]\n"
+                    "       [--format=16|24|float] [--suffix=<text>] [--multirate] --out=<dir> <input>...\n", argv[0]);
+    return 1;
+  }
+
+  const int numThreads = std::min(job.threads, (int)job.inputs.size());
+  std::atomic<size_t> next(0);
+  std::atomic<int> failures(0);
+  std::vector<double> audioSeconds(numThreads, 0.);
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < numThreads; t++) {
+    workers.push_back(std::thread([&, t]() {
+      MultibandEngine engine(44100.);
+      engine.SetMultirate(job.multirate);
+      size_t i;
+      while ((i = next++) < job.inputs.size()) {
+        std::string fileError;
+        const std::chrono::steady_clock::time_point fileStart = std::chrono::steady_clock::now();
+        const double seconds = RenderFile(job, engine, job.inputs[i], fileError);
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - fileStart).count();
+
+        std::lock_guard<std::mutex> lock(gPrintMutex);
+        if (seconds < 0.) {
+          failures++;
+          fprintf(stderr, "FAIL %s\n", fileError.c_str());
+        }
+        else {
+          audioSeconds[t] += seconds;
+          printf("ok   %s (%.1f s, %.0fx realtime)\n", job.inputs[i].c_str(), seconds, elapsed > 0. ? seconds / elapsed : 0.);
+        }
+        fflush(stdout);
+      }
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  double total = 0.;
+  for (int t = 0; t < numThreads; t++) total += audioSeconds[t];
+  printf("%d of %d file(s) rendered, %.1f s of audio in %.1f s on %d thread(s)\n",
+         (int)job.inputs.size() - failures.load(), (int)job.inputs.size(), total, elapsed, numThreads);
+  return failures.load() ? 1 : 0;
+}
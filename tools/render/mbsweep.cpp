@@ -0,0 +1,366 @@
+//
+//  mbsweep.cpp
+//  MultibandDistortion
+//
+//  Parameter grid renderer: renders one input file with every combination of
+//  the given parameter values, in parallel, and writes a manifest with the peak,
+//  RMS and integrated loudness of every render.
+//
+//  The input is decoded once and shared read-only by all workers. Combinations
+//  that only differ in band settings (drive, mode, mix...) share one band split:
+//  a worker splits the input once per block and runs all of its combinations'
+//  band processing from that split (MultibandEngine::SplitBlock/ProcessBands).
+//  Only the crossovers, input gain and the link switch need a split of their
+//  own. Linked combinations do not use the filterbank and are rendered whole.
+//
+//  mbsweep [options] --out=<dir> --grid=<axis>... <input>
+//    --grid=<name>=<values>  one axis of the grid: a parameter name (see
+//                            ParameterFile.h) or Drive, Mix, Mode for all four
+//                            bands, and comma separated values or lo:hi:step
+//    --params=<file>         settings for everything not on the grid
+//    --set=<name=value>      a single setting, applied after --params
+//    --threads=<n>           worker threads (default: one per core)
+//    --block-size=<n>        samples per processing block (default 512)
+//    --format=<f>            16, 24 or float (default float)
+//
+//  Example:
+//    mbsweep --out=sweep --grid="Drive=0:24:6" --grid="Mode=Excite,Tanh,Soft"
+//            --grid="Crossover 1: Freq=100,200" loop.wav
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MultibandEngine.h"
+#include "ParameterFile.h"
+#include "AudioFile.h"
+#include "Loudness.h"
+
+struct GridAxis
+{
+  std::string name;
+  std::vector<std::string> values;
+  bool affectsSplit;
+};
+
+struct Combination
+{
+  ParameterFile parameters;
+  std::vector<int> index; // value per axis
+  std::string file;
+  double peakDB, rmsDB, lufs;
+  bool ok;
+};
+
+// a group of combinations sharing one band split
+struct WorkItem
+{
+  std::vector<int> combinations;
+};
+
+static std::string Lower(const std::string& s)
+{
+  std::string out = s;
+  for (size_t i = 0; i < out.size(); i++) out[i] = (char)tolower((unsigned char)out[i]);
+  return out;
+}
+
+// Drive, Mix and Mode set all four bands
+static bool SetAxis(ParameterFile& parameters, const std::string& name, const std::string& value, std::string& error)
+{
+  const std::string key = Lower(name);
+  if (key == "drive" || key == "mix" || key == "mode") {
+    const std::string field = key == "drive" ? "Drive" : key == "mix" ? "Mix" : "Mode";
+    for (int j = 0; j < 4; j++) {
+      char band[32];
+      snprintf(band, sizeof(band), "Band %d: ", j + 1);
+      if (!parameters.Set(band + field, value, error)) return false;
+    }
+    return true;
+  }
+  return parameters.Set(name, value, error);
+}
+
+static bool ParseAxis(const std::string& spec, const ParameterFile& base, GridAxis& axis, std::string& error)
+{
+  const size_t eq = spec.find('=');
+  if (eq == std::string::npos) {
+    error = "expected --grid=<name>=<values>: " + spec;
+    return false;
+  }
+  axis.name = spec.substr(0, eq);
+  axis.values.clear();
+  const std::string key = Lower(axis.name);
+  axis.affectsSplit = key.compare(0, 10, "crossover ") == 0 || key == "input gain" || key == "link distortion modes";
+
+  std::string list = spec.substr(eq + 1);
+  size_t pos = 0;
+  while (pos <= list.size()) {
+    size_t comma = list.find(',', pos);
+    if (comma == std::string::npos) comma = list.size();
+    const std::string item = list.substr(pos, comma - pos);
+    double lo, hi, step;
+    if (sscanf(item.c_str(), "%lf:%lf:%lf", &lo, &hi, &step) == 3) {
+      if (step <= 0. || hi < lo) {
+        error = "invalid range " + item;
+        return false;
+      }
+      for (int i = 0; lo + i * step <= hi + 1e-9 * step; i++) {
+        char value[32];
+        snprintf(value, sizeof(value), "%g", lo + i * step);
+        axis.values.push_back(value);
+      }
+    }
+    else if (!item.empty()) axis.values.push_back(item);
+    pos = comma + 1;
+  }
+  if (axis.values.empty()) {
+    error = "no values for " + axis.name;
+    return false;
+  }
+
+  //catches unknown names and out of range values before anything is rendered
+  for (size_t v = 0; v < axis.values.size(); v++) {
+    ParameterFile check = base;
+    if (!SetAxis(check, axis.name, axis.values[v], error)) return false;
+  }
+  return true;
+}
+
+static void RenderItem(const WorkItem& item, std::vector<Combination>& combinations, const std::vector<double>* input,
+                       int nChannels, long long nFrames, double sampleRate, int blockSize, AudioFileWriter::Format format)
+{
+  const int count = (int)item.combinations.size();
+  const ParameterFile& shared = combinations[item.combinations[0]].parameters;
+
+  //all combinations of the item have the same input gain, crossovers and link switch
+  MultibandEngine splitter(sampleRate);
+  shared.Apply(splitter);
+  const bool linked = shared.linked;
+
+  std::vector<MultibandEngine*> engines(count);
+  std::vector<AudioFileWriter> writers(count);
+  std::vector<LoudnessMeter*> meters(count);
+  for (int k = 0; k < count; k++) {
+    Combination& c = combinations[item.combinations[k]];
+    engines[k] = new MultibandEngine(sampleRate);
+    c.parameters.Apply(*engines[k]);
+    meters[k] = new LoudnessMeter(sampleRate, nChannels);
+    std::string error;
+    c.ok = writers[k].Open(c.file, nChannels, sampleRate, format, error);
+    if (!c.ok) fprintf(stderr, "%s\n", error.c_str());
+  }
+
+  std::vector<double> split[4][kMaxChannels], out[kMaxChannels];
+  double* bandChannels[4][kMaxChannels];
+  double** bands[4];
+  double* outputs[kMaxChannels];
+  for (int c = 0; c < nChannels; c++) {
+    for (int j = 0; j < 4; j++) {
+      split[j][c].resize(blockSize);
+      bandChannels[j][c] = &split[j][c][0];
+    }
+    out[c].resize(blockSize);
+    outputs[c] = &out[c][0];
+  }
+  for (int j = 0; j < 4; j++) bands[j] = bandChannels[j];
+
+  for (long long pos = 0; pos < nFrames; pos += blockSize) {
+    const int n = (int)std::min((long long)blockSize, nFrames - pos);
+    double* inputs[kMaxChannels];
+    for (int c = 0; c < nChannels; c++) inputs[c] = const_cast<double*>(&input[c][pos]);
+
+    if (!linked) splitter.SplitBlock(inputs, bands, nChannels, n);
+    for (int k = 0; k < count; k++) {
+      Combination& c = combinations[item.combinations[k]];
+      if (!c.ok) continue;
+      if (linked) engines[k]->ProcessBlock(inputs, outputs, nChannels, n);
+      else engines[k]->ProcessBands(bands, outputs, nChannels, n);
+      meters[k]->Process(outputs, n);
+      if (!writers[k].Write(outputs, n)) c.ok = false;
+    }
+  }
+
+  for (int k = 0; k < count; k++) {
+    Combination& c = combinations[item.combinations[k]];
+    if (!writers[k].Close()) c.ok = false;
+    c.peakDB = meters[k]->GetPeakDB();
+    c.rmsDB = meters[k]->GetRMSDB();
+    c.lufs = meters[k]->GetIntegratedLUFS();
+    delete meters[k];
+    delete engines[k];
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ParameterFile base;
+  std::vector<std::string> gridSpecs;
+  std::string outputDir, inputPath, error;
+  int threads = std::max(1, (int)std::thread::hardware_concurrency());
+  int blockSize = 512;
+  AudioFileWriter::Format format = AudioFileWriter::Float32;
+
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    bool ok = true;
+    if (!strncmp(a, "--out=", 6)) outputDir = a + 6;
+    else if (!strncmp(a, "--grid=", 7)) gridSpecs.push_back(a + 7);
+    else if (!strncmp(a, "--params=", 9)) ok = base.Load(a + 9, error);
+    else if (!strncmp(a, "--set=", 6)) ok = base.Parse(a + 6, error);
+    else if (!strncmp(a, "--threads=", 10)) ok = (threads = atoi(a + 10)) > 0;
+    else if (!strncmp(a, "--block-size=", 13)) ok = (blockSize = atoi(a + 13)) > 0;
+    else if (!strcmp(a, "--format=16")) format = AudioFileWriter::PCM16;
+    else if (!strcmp(a, "--format=24")) format = AudioFileWriter::PCM24;
+    else if (!strcmp(a, "--format=float")) format = AudioFileWriter::Float32;
+    else if (a[0] != '-' && inputPath.empty()) inputPath = a;
+    else {
+      ok = false;
+      error = std::string("unexpected argument ") + a;
+    }
+    if (!ok) {
+      fprintf(stderr, "%s\n", error.empty() ? (std::string("invalid value: ") + a).c_str() : error.c_str());
+      return 1;
+    }
+  }
+  if (outputDir.empty() || inputPath.empty() || gridSpecs.empty()) {
+    fprintf(stderr, "usage: %s [--params=<file>] [--set=<name=value>]... [--threads=<n>] [--block-size=<n>]\n"
+                    "       [--format=16|24|float] --out=<dir> --grid=<name>=<values>... <input>\n", argv[0]);
+    return 1;
+  }
+
+  //the grid
+  std::vector<GridAxis> axes(gridSpecs.size());
+  long long numCombinations = 1;
+  for (size_t a = 0; a < gridSpecs.size(); a++) {
+    if (!ParseAxis(gridSpecs[a], base, axes[a], error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    numCombinations *= (long long)axes[a].values.size();
+  }
+  if (numCombinations > 100000) {
+    fprintf(stderr, "%lld combinations, that is too many\n", numCombinations);
+    return 1;
+  }
+
+  //decoded once, read by every worker
+  AudioFileReader reader;
+  if (!reader.Open(inputPath, error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  const int nChannels = reader.GetNumChannels();
+  if (nChannels > kMaxChannels) {
+    fprintf(stderr, "%s: too many channels\n", inputPath.c_str());
+    return 1;
+  }
+  const long long nFrames = reader.GetNumFrames();
+  const double sampleRate = reader.GetSampleRate();
+  std::vector<double> input[kMaxChannels];
+  {
+    double* channels[kMaxChannels];
+    for (int c = 0; c < nChannels; c++) {
+      input[c].resize((size_t)nFrames + 1);
+      channels[c] = &input[c][0];
+    }
+    for (long long pos = 0; pos < nFrames; pos += 65536) {
+      double* at[kMaxChannels];
+      for (int c = 0; c < nChannels; c++) at[c] = channels[c] + pos;
+      reader.Read(at, 65536);
+    }
+    reader.Close();
+  }
+
+  //every combination, grouped by the settings that change the split
+  std::vector<Combination> combinations((size_t)numCombinations);
+  std::map<std::vector<int>, std::vector<int> > groups;
+  for (long long n = 0; n < numCombinations; n++) {
+    Combination& c = combinations[(size_t)n];
+    c.parameters = base;
+    c.index.resize(axes.size());
+    std::vector<int> key;
+    long long rest = n;
+    for (int a = (int)axes.size() - 1; a >= 0; a--) {
+      c.index[a] = (int)(rest % axes[a].values.size());
+      rest /= axes[a].values.size();
+    }
+    for (size_t a = 0; a < axes.size(); a++) {
+      SetAxis(c.parameters, axes[a].name, axes[a].values[c.index[a]], error);
+      if (axes[a].affectsSplit) key.push_back(c.index[a]);
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "/sweep_%05lld.wav", n + 1);
+    c.file = outputDir + name;
+    c.ok = false;
+    groups[key].push_back((int)n);
+  }
+
+  //groups are cut into as many items as it takes to keep every thread busy;
+  //each item pays for one split
+  std::vector<WorkItem> items;
+  const int perGroup = std::max(1, (int)((threads + groups.size() - 1) / groups.size()));
+  for (std::map<std::vector<int>, std::vector<int> >::const_iterator g = groups.begin(); g != groups.end(); ++g) {
+    const int size = (int)g->second.size();
+    const int parts = std::min(perGroup, size);
+    for (int p = 0; p < parts; p++) {
+      WorkItem item;
+      for (int k = p * size / parts; k < (p + 1) * size / parts; k++) item.combinations.push_back(g->second[k]);
+      items.push_back(item);
+    }
+  }
+
+  printf("%lld combination(s) of %.1f s, %d band split(s) in %d work item(s) on %d thread(s)\n",
+         numCombinations, nFrames / sampleRate, (int)groups.size(), (int)items.size(), std::min(threads, (int)items.size()));
+  fflush(stdout);
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < std::min(threads, (int)items.size()); t++) {
+    workers.push_back(std::thread([&]() {
+      size_t i;
+      while ((i = next++) < items.size()) {
+        RenderItem(items[i], combinations, input, nChannels, nFrames, sampleRate, blockSize, format);
+      }
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  //manifest, one row per combination
+  const std::string manifestPath = outputDir + "/manifest.csv";
+  FILE* manifest = fopen(manifestPath.c_str(), "w");
+  if (!manifest) {
+    fprintf(stderr, "can not create %s\n", manifestPath.c_str());
+    return 1;
+  }
+  fprintf(manifest, "file");
+  for (size_t a = 0; a < axes.size(); a++) fprintf(manifest, ",\"%s\"", axes[a].name.c_str());
+  fprintf(manifest, ",peak_dbfs,rms_dbfs,loudness_lufs\n");
+  int failures = 0;
+  for (size_t n = 0; n < combinations.size(); n++) {
+    const Combination& c = combinations[n];
+    if (!c.ok) {
+      failures++;
+      continue;
+    }
+    const size_t slash = c.file.find_last_of('/');
+    fprintf(manifest, "%s", c.file.substr(slash + 1).c_str());
+    for (size_t a = 0; a < axes.size(); a++) fprintf(manifest, ",%s", axes[a].values[c.index[a]].c_str());
+    fprintf(manifest, ",%.2f,%.2f,%.2f\n", c.peakDB, c.rmsDB, c.lufs);
+  }
+  fclose(manifest);
+
+  printf("%d render(s) in %.1f s, manifest in %s\n", (int)combinations.size() - failures, elapsed, manifestPath.c_str());
+  if (failures) fprintf(stderr, "%d render(s) failed\n", failures);
+  return failures ? 1 : 0;
+}
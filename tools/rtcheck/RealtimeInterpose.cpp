@@ -0,0 +1,229 @@
+//
+//  RealtimeInterpose.cpp
+//  MultibandDistortion
+//
+//  Definitions in the executable take precedence over the C library's, so the
+//  functions below replace them for every caller. Allocations go on to glibc's
+//  __libc_* entry points; everything else to the next definition, found with
+//  dlsym(RTLD_NEXT). A thread that is already reporting passes its own calls
+//  through, so printing and stack walking can allocate freely.
+//
+//  Intercepted: malloc, calloc, realloc, free, posix_memalign, aligned_alloc,
+//  memalign (and with them operator new/delete), pthread_mutex_lock,
+//  pthread_cond_wait, pthread_cond_timedwait, sem_wait, nanosleep,
+//  clock_nanosleep, usleep, sleep, sched_yield, read, write and fsync.
+//
+
+#include "RealtimeInterpose.h"
+#include "RealtimeGuard.h"
+
+#include <atomic>
+#include <cstdio>
+
+#if defined(__linux__) && defined(__GLIBC__) && defined(RT_SAFETY_CHECKS)
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* p);
+}
+
+static std::atomic<int> gViolations(0);
+static std::atomic<int> gMaxReports(20);
+
+static thread_local bool tReporting = false;
+
+static void Report(const char* call)
+{
+  if (tReporting || !InRealtimeScope()) return;
+  tReporting = true;
+  RealtimeExempt exempt;
+
+  const int n = ++gViolations;
+  if (n <= gMaxReports.load()) {
+    fprintf(stderr, "real-time violation #%d: %s\n", n, call);
+    void* frames[32];
+    const int depth = backtrace(frames, 32);
+    //skips Report() itself
+    backtrace_symbols_fd(frames + 1, depth > 1 ? depth - 1 : 0, 2);
+    fputc('\n', stderr);
+  }
+  else if (n == gMaxReports.load() + 1) {
+    fprintf(stderr, "further violations are counted but not printed\n");
+  }
+  tReporting = false;
+}
+
+template <class T> static T Next(T& fn, const char* name)
+{
+  if (!fn) fn = (T)dlsym(RTLD_NEXT, name);
+  return fn;
+}
+
+#define RT_NEXT(name) static decltype(&::name) next_##name = 0; Next(next_##name, #name)
+
+void RealtimeInterposeInit()
+{
+  //backtrace() loads libgcc on first use, which allocates
+  void* frames[2];
+  backtrace(frames, 2);
+}
+
+int RealtimeViolations() { return gViolations.load(); }
+
+void RealtimeSetMaxReports(int n) { gMaxReports.store(n); }
+
+extern "C" {
+
+void* malloc(size_t size)
+{
+  Report("malloc");
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size)
+{
+  Report("calloc");
+  return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t size)
+{
+  Report("realloc");
+  return __libc_realloc(p, size);
+}
+
+void free(void* p)
+{
+  if (p) Report("free");
+  __libc_free(p);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+  Report("memalign");
+  return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+  Report("aligned_alloc");
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** p, size_t alignment, size_t size)
+{
+  Report("posix_memalign");
+  *p = __libc_memalign(alignment, size);
+  return *p ? 0 : ENOMEM;
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+  Report("pthread_mutex_lock");
+  RT_NEXT(pthread_mutex_lock);
+  return next_pthread_mutex_lock(mutex);
+}
+
+int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex)
+{
+  Report("pthread_cond_wait");
+  RT_NEXT(pthread_cond_wait);
+  return next_pthread_cond_wait(cond, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime)
+{
+  Report("pthread_cond_timedwait");
+  RT_NEXT(pthread_cond_timedwait);
+  return next_pthread_cond_timedwait(cond, mutex, abstime);
+}
+
+int sem_wait(sem_t* sem)
+{
+  Report("sem_wait");
+  RT_NEXT(sem_wait);
+  return next_sem_wait(sem);
+}
+
+int nanosleep(const struct timespec* req, struct timespec* rem)
+{
+  Report("nanosleep");
+  RT_NEXT(nanosleep);
+  return next_nanosleep(req, rem);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec* req, struct timespec* rem)
+{
+  Report("clock_nanosleep");
+  RT_NEXT(clock_nanosleep);
+  return next_clock_nanosleep(clock, flags, req, rem);
+}
+
+int usleep(useconds_t usec)
+{
+  Report("usleep");
+  RT_NEXT(usleep);
+  return next_usleep(usec);
+}
+
+unsigned int sleep(unsigned int seconds)
+{
+  Report("sleep");
+  RT_NEXT(sleep);
+  return next_sleep(seconds);
+}
+
+int sched_yield()
+{
+  Report("sched_yield");
+  RT_NEXT(sched_yield);
+  return next_sched_yield();
+}
+
+ssize_t read(int fd, void* buf, size_t count)
+{
+  Report("read");
+  RT_NEXT(read);
+  return next_read(fd, buf, count);
+}
+
+ssize_t write(int fd, const void* buf, size_t count)
+{
+  Report("write");
+  RT_NEXT(write);
+  return next_write(fd, buf, count);
+}
+
+int fsync(int fd)
+{
+  Report("fsync");
+  RT_NEXT(fsync);
+  return next_fsync(fd);
+}
+
+} // extern "C"
+
+#else
+
+// nothing to hook into: the check runs, but can not see anything
+void RealtimeInterposeInit()
+{
+  fprintf(stderr, "real-time checks need glibc and RT_SAFETY_CHECKS, nothing is intercepted\n");
+}
+
+int RealtimeViolations() { return 0; }
+
+void RealtimeSetMaxReports(int n) {}
+
+#endif
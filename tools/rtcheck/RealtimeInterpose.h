@@ -0,0 +1,24 @@
+//
+//  RealtimeInterpose.h
+//  MultibandDistortion
+//
+//  Reporting side of the real-time safety check. RealtimeInterpose.cpp replaces
+//  the C library's allocation, locking and blocking calls for the whole
+//  executable (glibc on Linux). Inside a RealtimeScope each call is reported on
+//  stderr with a stack trace and counted; outside, they pass straight through.
+//  Code built for the check needs RT_SAFETY_CHECKS so RealtimeGuard.h is live.
+//
+
+#ifndef RealtimeInterpose_h
+#define RealtimeInterpose_h
+
+// resolves the real functions and warms up the stack tracer, call before the first scope
+void RealtimeInterposeInit();
+
+// violations reported so far, on all threads
+int RealtimeViolations();
+
+// only the first few violations are printed in full, the rest are counted
+void RealtimeSetMaxReports(int n);
+
+#endif /* RealtimeInterpose_h */
@@ -0,0 +1,152 @@
+//
+//  rt_check.cpp
+//  MultibandDistortion
+//
+//  Real-time safety check of the engine. Every configuration (unlinked/linked x
+//  analyzer off/on x each mode) is rendered with program material, continuous
+//  automation and the discrete events of EventScript. Everything the audio
+//  thread does per block, parameter changes included, runs inside a
+//  RealtimeScope, so any allocation, lock or blocking call is reported with a
+//  stack trace. Any violation fails the run.
+//
+//  Command line:
+//    --seconds=<n>      rendered time per configuration (default 5)
+//    --block=<n>        block size (default 256)
+//    --max_reports=<n>  violations printed in full (default 20)
+//    --workers=<n>      band processing on a pool of n workers, which are
+//                       checked as well (default 0: serial)
+//    --multirate        low bands decimated, crossover moves change their rates
+//    --oversampling     every band's shaper on auto oversampling, drive moves
+//                       change the factors
+//    --fast             the table driven waveshapers
+//    --selftest         allocate inside a scope on purpose, passes if that is caught
+//
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MultibandEngine.h"
+#include "ProgramMaterial.h"
+#include "RealtimeGuard.h"
+#include "RealtimeInterpose.h"
+
+static int SelfTest()
+{
+  const int before = RealtimeViolations();
+  {
+    RealtimeScope realtime;
+    std::vector<double>* v = new std::vector<double>(16);
+    delete v;
+  }
+  const int caught = RealtimeViolations() - before;
+  printf("self test: %d violation(s) caught, %s\n", caught, caught >= 2 ? "ok" : "FAIL");
+  return caught >= 2 ? 0 : 1;
+}
+
+static int Check(bool linked, bool analyzer, int mode, double seconds, int blockSize, int workers, bool multirate, bool oversampling, bool fast)
+{
+  const double sampleRate = 44100.;
+  const int nChannels = 2;
+  MultibandEngine engine(sampleRate);
+  ProgramMaterial material(sampleRate);
+  AutomationScript automation(sampleRate, mode);
+  EventScript events(sampleRate);
+  engine.SetLinked(linked);
+  engine.SetMultirate(multirate);
+  for (int j=0; j<4; j++) engine.SetOversampling(j, oversampling ? 0 : 1);
+  engine.SetFastShapers(fast);
+  WorkerPool pool(workers);
+  if (workers) engine.SetWorkerPool(&pool, 1);
+
+  Spect_TapRing ring(kNumTaps, 1 << 14);
+  if (analyzer) engine.SetTaps(&ring, (1u << kNumTaps) - 1);
+  std::atomic<bool> running(true);
+  std::thread editor([&]() {
+    while (running.load()) {
+      ring.Discard();
+      std::this_thread::sleep_for(std::chrono::milliseconds(16));
+    }
+  });
+
+  std::vector<double> in[2], out[2];
+  double* inputs[2];
+  double* outputs[2];
+  for (int c=0; c<nChannels; c++) {
+    in[c].resize(blockSize);
+    out[c].resize(blockSize);
+    inputs[c] = &in[c][0];
+    outputs[c] = &out[c][0];
+  }
+
+  const int before = RealtimeViolations();
+  const long long total = (long long)(seconds * sampleRate);
+  for (long long pos = 0; pos < total; pos += blockSize) {
+    material.Render(inputs, nChannels, blockSize);
+
+    RealtimeScope realtime;
+    automation.Apply(engine, pos);
+    events.Apply(engine, &ring, pos);
+    engine.ProcessBlock(inputs, outputs, nChannels, blockSize);
+  }
+
+  running.store(false);
+  editor.join();
+  return RealtimeViolations() - before;
+}
+
+int main(int argc, char** argv)
+{
+  double seconds = 5.;
+  int blockSize = 256;
+  bool selfTest = false;
+  int workers = 0;
+  bool multirate = false;
+  bool oversampling = false;
+  bool fast = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strncmp(argv[i], "--seconds=", 10)) seconds = atof(argv[i] + 10);
+    else if (!strncmp(argv[i], "--block=", 8)) blockSize = atoi(argv[i] + 8);
+    else if (!strncmp(argv[i], "--max_reports=", 14)) RealtimeSetMaxReports(atoi(argv[i] + 14));
+    else if (!strcmp(argv[i], "--selftest")) selfTest = true;
+    else if (!strncmp(argv[i], "--workers=", 10)) workers = atoi(argv[i] + 10);
+    else if (!strcmp(argv[i], "--multirate")) multirate = true;
+    else if (!strcmp(argv[i], "--oversampling")) oversampling = true;
+    else if (!strcmp(argv[i], "--fast")) fast = true;
+    else {
+      fprintf(stderr, "usage: %s [--seconds=<n>] [--block=<n>] [--max_reports=<n>] [--workers=<n>] [--multirate] [--oversampling] [--fast] [--selftest]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (seconds <= 0. || blockSize <= 0 || workers < 0) {
+    fprintf(stderr, "seconds and block must be positive, workers not negative\n");
+    return 1;
+  }
+
+  RealtimeInterposeInit();
+  if (selfTest) return SelfTest();
+
+  static const char* modeNames[NumDistortionModes] = { "Excite", "Fat", "Sine", "Fold", "Tanh", "Soft", "Cheby" };
+  int failures = 0;
+  for (int linked = 0; linked < 2; linked++) {
+    for (int analyzer = 0; analyzer < 2; analyzer++) {
+      for (int mode = -1; mode < NumDistortionModes; mode++) {
+        const int violations = Check(linked != 0, analyzer != 0, mode, seconds, blockSize, workers, multirate, oversampling, fast);
+        const std::string name = std::string(linked ? "linked" : "unlinked") + "/" + (analyzer ? "analyzer" : "no-analyzer") + "/" + (mode < 0 ? "cycling" : modeNames[mode]);
+        printf("%-32s %s", name.c_str(), violations ? "FAIL" : "ok");
+        if (violations) printf(", %d violation(s)", violations);
+        printf("\n");
+        fflush(stdout);
+        failures += violations != 0;
+      }
+    }
+  }
+
+  if (failures) printf("%d configuration(s) not real-time safe\n", failures);
+  else printf("all configurations real-time safe\n");
+  return failures ? 1 : 0;
+}